@@ -0,0 +1,71 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "lz.h"
+
+/*
+ * The sender's batches come as LZ4 blocks, see lz.c in the kernel module.
+ * Matches may overlap what they produce, so they are copied a byte at a
+ * time.
+ */
+static int get_len(const uint8_t **ip, const uint8_t *iend, int *len){
+	uint8_t c;
+
+	do{
+		if(*ip >= iend){
+			return -1;
+		}
+		c = *(*ip)++;
+		*len += c;
+	}while(c == 255);
+	return 0;
+}
+
+int lz_decompress(const char *src, int src_len, char *dst, int dst_size){
+	const uint8_t *ip = (const uint8_t *)src;
+	const uint8_t *iend = ip + src_len;
+	uint8_t *op = (uint8_t *)dst;
+	uint8_t *oend = op + dst_size;
+
+	while(ip < iend){
+		unsigned int token = *ip++;
+		int lit = token >> 4, mlen = token & 15, off;
+		const uint8_t *ref;
+
+		if(lit == 15 && get_len(&ip, iend, &lit) < 0){
+			return -1;
+		}
+		if(lit > iend - ip || lit > oend - op){
+			return -1;
+		}
+		memcpy(op, ip, lit);
+		op += lit;
+		ip += lit;
+
+		// the last sequence has no match
+		if(ip == iend){
+			break;
+		}
+
+		if(iend - ip < 2){
+			return -1;
+		}
+		off = ip[0] | ip[1] << 8;
+		ip += 2;
+		if(off == 0 || off > op - (uint8_t *)dst){
+			return -1;
+		}
+		if(mlen == 15 && get_len(&ip, iend, &mlen) < 0){
+			return -1;
+		}
+		mlen += 4;
+		if(mlen > oend - op){
+			return -1;
+		}
+		for(ref = op - off; mlen > 0; mlen--){
+			*op++ = *ref++;
+		}
+	}
+
+	return op - (uint8_t *)dst;
+}
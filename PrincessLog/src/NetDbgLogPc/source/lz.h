@@ -0,0 +1,7 @@
+#ifndef LZ_H
+#define LZ_H
+
+// an LZ4 block into dst, returns its length or -1 if it is bad or does not fit
+int lz_decompress(const char *src, int src_len, char *dst, int dst_size);
+
+#endif
@@ -9,6 +9,9 @@
 #include <stdlib.h>
 
 #include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include "wire.h"
 
 
 #define DEFAULT_PORT 8080
@@ -25,6 +28,32 @@ char *name;
 	int writer_len = sizeof(writer_addr);
 	
 	int port = DEFAULT_PORT;
+
+// datagrams from NetLoggingMgr's UDP mode, one sender at a time
+int udp_loop(int sockfd){
+
+	static char dgram[0x10000];
+
+	while(1){
+		writer_len = sizeof(writer_addr);
+		int received = recvfrom(sockfd, dgram, sizeof(dgram), 0, (struct sockaddr *)&writer_addr, &writer_len);
+
+		if(received < 0){
+			if(WSAGetLastError() != WSAETIMEDOUT){
+				printf("recvfrom error 0x%X\n", WSAGetLastError());
+				break;
+			}
+			// quiet for a while, the sender stopped
+			wire_quiet();
+			continue;
+		}
+
+		wire_datagram(dgram, received);
+	}
+
+	return 0;
+}
+
 int main(int argc, char* argv[]){
 
 	int number;
@@ -35,7 +64,10 @@ int main(int argc, char* argv[]){
 	WSADATA wsaData;
 	WSAStartup(versionWanted, &wsaData);
 
-	sockfd = socket(AF_INET, SOCK_STREAM, 0);
+	// NetDbgLogPc [port] [udp [multicast group]]
+	int udp = argc > 2 && strcmp(argv[2], "udp") == 0;
+
+	sockfd = socket(AF_INET, udp ? SOCK_DGRAM : SOCK_STREAM, 0);
 
 	if(sockfd < 0){
 
@@ -77,6 +109,25 @@ int main(int argc, char* argv[]){
 		return 0;
 	}
 
+	if(udp){
+		if(argc > 3){
+			struct ip_mreq mreq;
+
+			mreq.imr_multiaddr.s_addr = inet_addr(argv[3]);
+			mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+			if(setsockopt(sockfd, IPPROTO_IP, IP_ADD_MEMBERSHIP, (char*)&mreq, sizeof(mreq)) < 0){
+				printf("cannot join %s\n", argv[3]);
+			}
+		}
+		printf("listening for datagrams\n");
+
+		udp_loop(sockfd);
+
+		closesocket(sockfd);
+		WSACleanup();
+		return 0;
+	}
+
 	if(listen(sockfd, 128) < 0){
 
 		close(sockfd);
@@ -96,12 +147,42 @@ int main(int argc, char* argv[]){
 		}
 
 		int received = 0;
+		BOOL keepalive = TRUE;
+
+		// a sender that vanished without closing is noticed eventually
+		setsockopt(new_sockfd, SOL_SOCKET, SO_KEEPALIVE, (char*)&keepalive, sizeof(keepalive));
+
+		wire_reset();
+
+		while (1) {
+			fd_set fds;
+			struct timeval wait = { 5, 0 };
+
+			FD_ZERO(&fds);
+			FD_SET(new_sockfd, &fds);
+			FD_SET(sockfd, &fds);
+			int ready = select((new_sockfd > sockfd ? new_sockfd : sockfd) + 1, &fds, NULL, NULL, &wait);
+
+			if (ready < 0) {
+				break;
+			}
+			// the sender keeps the connection between bursts
+			if (ready == 0) {
+				fflush(stdout);
+				continue;
+			}
+			// a new connection means the sender came back, this one is dead or about to be
+			if (FD_ISSET(sockfd, &fds)) {
+				break;
+			}
+			received = recv(new_sockfd, buf, sizeof(buf), 0);
+			if (received <= 0) {
+				break;
+			}
+			wire_input(buf, received);
+		}
 
-		do {
-			memset(buf, 0x00, sizeof(buf));
-			received = recv(new_sockfd, buf, sizeof(buf) - 1, 0);
-			printf("%s", buf);
-		} while (received > 0);
+		wire_end();
 
 		closesocket(new_sockfd);
 	}
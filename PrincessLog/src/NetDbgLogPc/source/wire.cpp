@@ -0,0 +1,590 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+
+#include "wire.h"
+#include "lz.h"
+#include "../../NetLoggingMgr/include/NetLoggingMgrWire.h"
+
+/*
+ * A connection is plain text unless it starts with the NLMB hello, then
+ * it is frames as described in NetLoggingMgrWire.h. FMT frames are
+ * formatted here with the sender's argument sizes from the hello. DICT
+ * frames fill the connection's dictionary that FMT_ID frames refer to.
+ * Lines are prefixed with the time, pid and tid of the frame they start in.
+ * Gaps in the record sequence are reported where they are, and the loss
+ * of the whole connection when it ends. The first timed frame of a session
+ * is where its sequence starts, whatever came before it. Datagrams decode
+ * the same way, each on its own but for seq and pos, and a session ends
+ * when the sequence starts over or the sender goes quiet. LZ frames are
+ * unpacked and their frames handled like the others.
+ */
+#define WIRE_DETECT 0
+#define WIRE_TEXT 1
+#define WIRE_BINARY 2
+#define WIRE_BAD 3	// lost track of the frames, the rest of the connection is dropped
+
+#define WIRE_BUF_LEN (NLM_WIRE_FRAME_MAX + 1)
+#define WIRE_TEXT_LEN 0x1000
+#define WIRE_SPEC_MAX 16
+#define WIRE_DICT_LEN 0x10000
+#define WIRE_VERSION_MIN 3	// frame headers were fixed size before
+
+typedef struct {
+	int type;
+	int level;
+	int timed;		// meta is this frame's, else it is the one before
+	unsigned int len;	// of the body
+	NetLoggingMgrWireMeta_t meta;
+} wire_rec;
+
+static int mode;
+static char buf[WIRE_BUF_LEN];
+static int buf_len;
+static NetLoggingMgrWireHello_t hello;
+static char *dict[WIRE_DICT_LEN];
+static NetLoggingMgrWireMeta_t meta;
+static int line_start;
+static int in_session;	// a timed frame came since the session started
+static unsigned long long recs, lost, lost_bytes;
+
+void wire_reset(void){
+	mode = WIRE_DETECT;
+	buf_len = 0;
+	memset(&hello, 0, sizeof(hello));
+	memset(&meta, 0, sizeof(meta));
+	line_start = 1;
+	in_session = 0;
+	recs = 0;
+	lost = 0;
+	lost_bytes = 0;
+	for(int i = 0; i < WIRE_DICT_LEN; i++){
+		free(dict[i]);
+		dict[i] = NULL;
+	}
+}
+
+static int get(const char *in, unsigned int len, unsigned int *n, void *v, unsigned int size){
+	if(size > len - *n){
+		return -1;
+	}
+	memcpy(v, in + *n, size);
+	*n += size;
+	return 0;
+}
+
+// an integer of size bytes, sign extended if it is signed
+static long long get_int(const char *in, unsigned int len, unsigned int *n, unsigned int size, int is_signed, int *err){
+	uint64_t v = 0;
+
+	if(size > 8 || get(in, len, n, &v, size) < 0){
+		*err = 1;
+		return 0;
+	}
+	if(is_signed && size < 8 && (v >> (size * 8 - 1)) & 1){
+		v |= ~(uint64_t)0 << (size * 8);
+	}
+	return (long long)v;
+}
+
+/*
+ * Format fmt with the packed arguments, see NetLoggingMgrWire.h. Integer
+ * conversions are redone as long long so the sizes of the sender do not
+ * matter here.
+ */
+static int wire_format(char *out, int size, const char *fmt, const char *args, unsigned int len){
+	char spec[WIRE_SPEC_MAX + 4];
+	unsigned int in = 0;
+	int n = 0, ret, err = 0;
+
+	for(const char *p = fmt; *p != '\0' && n < size - 1; ){
+		const char *q = p + 1;
+		int star[2], n_star = 0, n_long = 0, spec_len;
+
+		if(*p != '%'){
+			out[n++] = *p++;
+			continue;
+		}
+
+		while(*q == '-' || *q == '+' || *q == ' ' || *q == '#' || *q == '0'){
+			q++;
+		}
+		if(*q == '*'){
+			star[n_star++] = (int)get_int(args, len, &in, 4, 1, &err);
+			q++;
+		}
+		while(*q >= '0' && *q <= '9'){
+			q++;
+		}
+		if(*q == '.'){
+			q++;
+			if(*q == '*'){
+				star[n_star++] = (int)get_int(args, len, &in, 4, 1, &err);
+				q++;
+			}
+			while(*q >= '0' && *q <= '9'){
+				q++;
+			}
+		}
+
+		// flags, width and precision stay, the length modifier is redone
+		spec_len = q - p;
+		if(spec_len > WIRE_SPEC_MAX){
+			break;
+		}
+		memcpy(spec, p, spec_len);
+
+		switch(*q){
+		case 'h':
+			q += q[1] == 'h' ? 2 : 1;
+			break;
+		case 'l':
+			n_long = q[1] == 'l' ? 2 : 1;
+			q += n_long;
+			break;
+		case 'L':
+		case 'q':
+		case 'j':
+			n_long = 2;
+			q++;
+			break;
+		case 'z':
+		case 't':
+			n_long = 1;
+			q++;
+			break;
+		}
+
+#define FORMAT(v) ( \
+	n_star == 0 ? snprintf(out + n, size - n, spec, (v)) : \
+	n_star == 1 ? snprintf(out + n, size - n, spec, star[0], (v)) : \
+	snprintf(out + n, size - n, spec, star[0], star[1], (v)))
+
+		switch(*q){
+		case 'd':
+		case 'i':
+		case 'u':
+		case 'o':
+		case 'x':
+		case 'X': {
+			unsigned int arg_size = n_long == 2 ? 8 : n_long ? hello.long_size : 4;
+			long long v = get_int(args, len, &in, arg_size, *q == 'd' || *q == 'i', &err);
+
+			memcpy(spec + spec_len, "ll", 2);
+			spec[spec_len + 2] = *q;
+			spec[spec_len + 3] = '\0';
+			ret = FORMAT(v);
+			break;
+		}
+		case 'c': {
+			int v = (int)get_int(args, len, &in, 4, 1, &err);
+
+			spec[spec_len] = 'c';
+			spec[spec_len + 1] = '\0';
+			ret = FORMAT(v);
+			break;
+		}
+		case 'p': {
+			unsigned long long v = (unsigned long long)get_int(args, len, &in, hello.ptr_size, 0, &err);
+
+			ret = snprintf(out + n, size - n, "0x%0*llx", hello.ptr_size * 2, v);
+			break;
+		}
+		case 's': {
+			const char *str = args + in;
+			unsigned int str_len = strnlen(str, len - in);
+
+			if(str_len == len - in){
+				err = 1;
+				break;
+			}
+			in += str_len + 1;
+			spec[spec_len] = 's';
+			spec[spec_len + 1] = '\0';
+			ret = FORMAT(str);
+			break;
+		}
+		case 'n':
+			ret = 0;
+			break;
+		case '%':
+			out[n++] = '%';
+			ret = 0;
+			break;
+		default:
+			err = 1;
+			break;
+		}
+
+#undef FORMAT
+
+		if(err || ret < 0){
+			break;
+		}
+		n += ret;
+		if(n > size - 1){
+			n = size - 1;
+		}
+		p = q + 1;
+	}
+
+	out[n] = '\0';
+	return n;
+}
+
+// a line of our own between the sender's
+static void wire_note(const char *fmt, ...){
+	va_list args;
+
+	va_start(args, fmt);
+	printf(line_start ? "[NetDbgLogPc] " : "\n[NetDbgLogPc] ");
+	vprintf(fmt, args);
+	printf("\n");
+	va_end(args);
+	line_start = 1;
+}
+
+static void wire_text(const wire_rec *rec, const char *text, unsigned int len){
+	while(len > 0){
+		const char *nl = (const char *)memchr(text, '\n', len);
+		unsigned int n = nl ? nl - text + 1 : len;
+
+		// empty lines stay empty
+		if(line_start && rec->timed && n > 1){
+			printf("[%5llu.%06llu %08X %08X] ",
+				(unsigned long long)(rec->meta.time / 1000000), (unsigned long long)(rec->meta.time % 1000000),
+				rec->meta.pid, rec->meta.tid);
+		}
+		fwrite(text, 1, n, stdout);
+		line_start = nl != NULL;
+		text += n;
+		len -= n;
+	}
+}
+
+static void wire_frame(const wire_rec *rec, const char *body, unsigned int len){
+	static char text[WIRE_TEXT_LEN];
+	unsigned int fmt_len;
+	uint16_t id;
+	int n;
+
+	switch(rec->type){
+	case NLM_WIRE_TYPE_TEXT:
+		wire_text(rec, body, len);
+		break;
+	case NLM_WIRE_TYPE_FMT:
+		fmt_len = strnlen(body, len);
+		if(fmt_len == len){
+			wire_note("bad FMT frame");
+			break;
+		}
+		n = wire_format(text, sizeof(text), body, body + fmt_len + 1, len - fmt_len - 1);
+		wire_text(rec, text, n);
+		break;
+	case NLM_WIRE_TYPE_DICT:
+		if(len < sizeof(id) || strnlen(body + sizeof(id), len - sizeof(id)) == len - sizeof(id)){
+			wire_note("bad DICT frame");
+			break;
+		}
+		memcpy(&id, body, sizeof(id));
+		free(dict[id]);
+		dict[id] = strdup(body + sizeof(id));
+		break;
+	case NLM_WIRE_TYPE_FMT_ID:
+		if(len < sizeof(id)){
+			wire_note("bad FMT_ID frame");
+			break;
+		}
+		memcpy(&id, body, sizeof(id));
+		if(dict[id] == NULL){
+			wire_note("unknown format id %u", id);
+			break;
+		}
+		n = wire_format(text, sizeof(text), dict[id], body + sizeof(id), len - sizeof(id));
+		wire_text(rec, text, n);
+		break;
+	case NLM_WIRE_TYPE_LOST:
+		// wire_seq told about it
+		break;
+	case NLM_WIRE_TYPE_LZ:
+		// wire_parse unpacks these
+		break;
+	default:
+		// from a newer sender, skip it
+		break;
+	}
+}
+
+// 0 if it is there, 1 if more bytes are needed and -1 if it is too long
+static int get_varint(const char *in, int len, int *n, uint64_t *v){
+	*v = 0;
+	for(int shift = 0; shift < 70; shift += 7){
+		uint8_t c;
+
+		if(*n >= len){
+			return 1;
+		}
+		c = in[(*n)++];
+		*v |= (uint64_t)(c & 0x7F) << shift;
+		if(!(c & 0x80)){
+			return 0;
+		}
+	}
+	return -1;
+}
+
+// a frame header on top of the current meta, returns its length like get_varint
+static int wire_hdr(const char *in, int len, wire_rec *rec, int *hdr_len){
+	uint64_t v;
+	int n = 2, ret;
+	unsigned int flags;
+
+	if(len < 2){
+		return 1;
+	}
+	rec->type = (uint8_t)in[0];
+	flags = (uint8_t)in[1];
+	rec->level = flags & NLM_WIRE_META_LEVEL;
+	rec->timed = !(flags & NLM_WIRE_META_NO_TIME);
+	rec->meta = meta;
+
+	if((ret = get_varint(in, len, &n, &v)) != 0){
+		return ret;
+	}
+	rec->len = v;
+
+	if(rec->timed){
+		if((ret = get_varint(in, len, &n, &v)) != 0){
+			return ret;
+		}
+		rec->meta.time += (int64_t)((v >> 1) ^ -(v & 1));
+		rec->meta.level = rec->level;
+		if(flags & NLM_WIRE_META_SOURCE){
+			if(n >= len){
+				return 1;
+			}
+			rec->meta.source = in[n++];
+		}
+		if(flags & NLM_WIRE_META_PID){
+			if((ret = get_varint(in, len, &n, &v)) != 0){
+				return ret;
+			}
+			rec->meta.pid = v;
+		}
+		if(flags & NLM_WIRE_META_TID){
+			if((ret = get_varint(in, len, &n, &v)) != 0){
+				return ret;
+			}
+			rec->meta.tid = v;
+		}
+		if(flags & NLM_WIRE_META_SEQ){
+			if((ret = get_varint(in, len, &n, &v)) != 0){
+				return ret;
+			}
+			rec->meta.seq = v;
+			if((ret = get_varint(in, len, &n, &v)) != 0){
+				return ret;
+			}
+			rec->meta.pos = v;
+		}
+	}
+
+	*hdr_len = n;
+	return 0;
+}
+
+static void wire_session_end(void){
+	if(recs + lost > 0){
+		wire_note("%llu records, %llu lost (%.2f%%, %llu bytes)", recs, lost, lost * 100.0 / (recs + lost), lost_bytes);
+	}
+	in_session = 0;
+	recs = 0;
+	lost = 0;
+	lost_bytes = 0;
+}
+
+// a timed frame moves meta on, and tells about records that did not make it
+static void wire_seq(const wire_rec *rec){
+	int32_t gap = rec->meta.seq - meta.seq;
+
+	if(!in_session){
+		// nothing to compare with, a receiver started late is not a loss
+	}else if(gap > 0){
+		wire_note("lost %d records / %llu bytes", gap, (unsigned long long)(rec->meta.pos - meta.pos));
+		lost += gap;
+		lost_bytes += rec->meta.pos - meta.pos;
+	}else if(gap < 0){
+		// the sender started over, as it does for each connection
+		wire_session_end();
+	}
+
+	in_session = 1;
+	meta = rec->meta;
+	if(rec->type == NLM_WIRE_TYPE_TEXT || rec->type == NLM_WIRE_TYPE_FMT || rec->type == NLM_WIRE_TYPE_FMT_ID){
+		meta.seq++;
+		meta.pos += rec->len;
+		recs++;
+	}
+}
+
+static int wire_parse(const char *in, int len, int *off);
+
+// the frames of an LZ frame, which does not hold any more of them
+static void wire_block(const char *body, unsigned int len){
+	static char block[NLM_WIRE_FRAME_MAX];
+	static int in_block;
+	uint64_t raw;
+	int n = 0, off = 0;
+
+	if(in_block || get_varint(body, len, &n, &raw) != 0 || raw > sizeof(block) ||
+		lz_decompress(body + n, len - n, block, raw) != (int)raw){
+		wire_note("bad LZ frame");
+		return;
+	}
+
+	in_block = 1;
+	if(wire_parse(block, raw, &off) < 0 || off != (int)raw){
+		wire_note("LZ frame ends in the middle of a frame");
+	}
+	in_block = 0;
+}
+
+// the whole frames in in, returns -1 if a header is bad
+static int wire_parse(const char *in, int len, int *off){
+	wire_rec rec;
+	int hdr_len, ret;
+
+	while((ret = wire_hdr(in + *off, len - *off, &rec, &hdr_len)) == 0){
+		if(hdr_len + rec.len > NLM_WIRE_FRAME_MAX){
+			return -1;
+		}
+		if((unsigned int)(len - *off - hdr_len) < rec.len){
+			break;
+		}
+		if(rec.timed){
+			wire_seq(&rec);
+		}
+		if(rec.type == NLM_WIRE_TYPE_LZ){
+			wire_block(in + *off + hdr_len, rec.len);
+		}else{
+			wire_frame(&rec, in + *off + hdr_len, rec.len);
+		}
+		*off += hdr_len + rec.len;
+	}
+
+	return ret < 0 ? -1 : 0;
+}
+
+// handle the buffered frames, keeps a partial one for later
+static void wire_frames(void){
+	int off = 0;
+
+	if(wire_parse(buf, buf_len, &off) < 0){
+		wire_note("bad frame header, dropping the rest of the stream");
+		mode = WIRE_BAD;
+		buf_len = 0;
+		return;
+	}
+
+	memmove(buf, buf + off, buf_len - off);
+	buf_len -= off;
+}
+
+void wire_input(const char *data, int len){
+
+	if(mode == WIRE_TEXT){
+		fwrite(data, 1, len, stdout);
+		return;
+	}
+
+	while(len > 0 && mode != WIRE_BAD){
+		int n = WIRE_BUF_LEN - buf_len;
+
+		if(n > len){
+			n = len;
+		}
+		memcpy(buf + buf_len, data, n);
+		buf_len += n;
+		data += n;
+		len -= n;
+
+		if(mode == WIRE_DETECT){
+			int magic_len = strlen(NLM_WIRE_MAGIC);
+			int cmp_len = buf_len < magic_len ? buf_len : magic_len;
+
+			if(memcmp(buf, NLM_WIRE_MAGIC, cmp_len) != 0){
+				// an older sender or binary mode off
+				mode = WIRE_TEXT;
+				fwrite(buf, 1, buf_len, stdout);
+				fwrite(data, 1, len, stdout);
+				buf_len = 0;
+				return;
+			}
+			if(buf_len < (int)sizeof(hello)){
+				continue;
+			}
+			memcpy(&hello, buf, sizeof(hello));
+			if(hello.version < WIRE_VERSION_MIN){
+				wire_note("sender uses wire version %u, which is not supported anymore", hello.version);
+				mode = WIRE_BAD;
+				buf_len = 0;
+				return;
+			}
+			if(hello.version > NLM_WIRE_VERSION){
+				wire_note("sender uses wire version %u, frames it added are skipped", hello.version);
+			}
+			memmove(buf, buf + sizeof(hello), buf_len - sizeof(hello));
+			buf_len -= sizeof(hello);
+			mode = WIRE_BINARY;
+		}
+
+		wire_frames();
+	}
+}
+
+// the connection closed
+void wire_end(void){
+	if(mode == WIRE_DETECT){
+		fwrite(buf, 1, buf_len, stdout);
+	}else if(mode == WIRE_BINARY && buf_len > 0){
+		wire_note("connection closed in the middle of a frame");
+	}
+	if(mode == WIRE_BINARY){
+		wire_session_end();
+	}
+	fflush(stdout);
+	wire_reset();
+}
+
+void wire_datagram(const char *data, int len){
+	uint32_t seq = meta.seq;
+	uint64_t pos = meta.pos;
+
+	mode = WIRE_DETECT;
+	buf_len = 0;
+	memset(&meta, 0, sizeof(meta));
+	meta.seq = seq;
+	meta.pos = pos;
+
+	wire_input(data, len);
+
+	if(mode == WIRE_DETECT){
+		fwrite(buf, 1, buf_len, stdout);
+	}else if(mode == WIRE_BINARY && buf_len > 0){
+		wire_note("datagram ends in the middle of a frame");
+	}
+	if(mode == WIRE_BAD){
+		// only this datagram is lost, the session goes on
+		mode = WIRE_BINARY;
+	}
+	buf_len = 0;
+	fflush(stdout);
+}
+
+// unlike wire_end, meta stays for the datagrams that continue the sequence
+void wire_quiet(void){
+	wire_session_end();
+	fflush(stdout);
+}
@@ -0,0 +1,14 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+// decodes one connection's stream to stdout, binary frames or plain text
+void wire_reset(void);
+void wire_input(const char *data, int len);
+void wire_end(void);
+
+// one datagram, which only depends on the ones before for seq and pos
+void wire_datagram(const char *data, int len);
+// the datagram sender went quiet, its session ends but seq and pos carry on
+void wire_quiet(void);
+
+#endif
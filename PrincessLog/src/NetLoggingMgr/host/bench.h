@@ -0,0 +1,33 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+// shared by the host benchmarks, header only so each one stays a single file
+
+static inline uint64_t bench_now_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int bench_cmp_u32(const void *a, const void *b) {
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+// sorts the samples, then pct[i] is the p[i] quantile of them
+static inline void bench_percentiles(uint32_t *s, size_t n, const double *p, uint32_t *pct, int n_p) {
+	qsort(s, n, sizeof(*s), bench_cmp_u32);
+	for (int i = 0; i < n_p; i++) {
+		size_t k = (size_t)(p[i] * n);
+
+		pct[i] = n == 0 ? 0 : s[k < n ? k : n - 1];
+	}
+}
+
+#endif
@@ -0,0 +1,127 @@
+/*
+PSVita RE Tools: NetLoggingMgr aka PrincessLog
+Copyright (C) 2020 Asakura Reiko
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include "bench.h"
+#include "ringbuf.h"
+
+/*
+ * Single thread copy cost of the ring: fill half of it with messages, then
+ * read it all back with ringbuf_get(), over and over. For reference the
+ * same with the byte at a time, modulo indexed, mutex guarded ring the
+ * module started from.
+ */
+#define RING_SIZE 0x10000
+#define RUN_BYTES (256 << 20)	// per row
+
+// the original ring, one byte at a time
+static char old_buf[RING_SIZE];
+static char *old_get = old_buf, *old_put = old_buf;
+static pthread_mutex_t old_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+static int old_idx(char *ptr) {
+	return (unsigned int)(ptr - old_buf) % RING_SIZE;
+}
+
+static void old_inc(char **ptr) {
+	*ptr = old_buf + old_idx(*ptr + 1);
+}
+
+static int old_ringbuf_put(char *c, int size) {
+	int i;
+
+	pthread_mutex_lock(&old_mtx);
+	for (i = 0; i < size; i++) {
+		if (old_idx(old_put + 1) == old_idx(old_get)) {
+			break;
+		}
+		*old_put = c[i];
+		old_inc(&old_put);
+	}
+	pthread_mutex_unlock(&old_mtx);
+	return i;
+}
+
+static int old_ringbuf_get(char *c, int size) {
+	int i;
+
+	pthread_mutex_lock(&old_mtx);
+	for (i = 0; i < size && old_get != old_put; i++) {
+		c[i] = *old_get;
+		old_inc(&old_get);
+	}
+	pthread_mutex_unlock(&old_mtx);
+	return i;
+}
+
+static void run(const char *name, int size, ringbuf *rb) {
+	static char out[0x1000];
+	char msg[1024];
+	int per_fill = RING_SIZE / 2 / (size + 16);	// leave room for record headers
+	uint64_t n_msg = 0, put_ns = 0, get_ns = 0, t0, t1;
+	uint64_t bytes = 0;
+
+	memset(msg, 'x', size);
+
+	while (bytes < RUN_BYTES) {
+		int n;
+
+		t0 = bench_now_ns();
+		for (int i = 0; i < per_fill; i++) {
+			if ((rb != NULL ? ringbuf_put(rb, msg, size) : old_ringbuf_put(msg, size)) != size) {
+				printf("%s: put failed\n", name);
+				return;
+			}
+		}
+		t1 = bench_now_ns();
+		put_ns += t1 - t0;
+
+		do {
+			n = rb != NULL ? ringbuf_get(rb, out, sizeof(out)) : old_ringbuf_get(out, sizeof(out));
+		} while (n > 0);
+		get_ns += bench_now_ns() - t1;
+
+		n_msg += per_fill;
+		bytes += (uint64_t)per_fill * size;
+	}
+
+	printf("%-9s %5d %9.1f %8.1f %9.1f %8.1f\n", name, size,
+		bytes / (put_ns / 1e3), (double)put_ns / n_msg,
+		bytes / (get_ns / 1e3), (double)get_ns / n_msg);
+}
+
+int main(void) {
+	static const int sizes[] = { 16, 128, 1024 };
+	ringbuf *rb = ringbuf_create(RING_SIZE, 0);
+
+	if (rb == NULL) {
+		printf("ringbuf_create failed\n");
+		return 1;
+	}
+
+	printf("%d byte ring, %d MB per row\n", RING_SIZE, RUN_BYTES >> 20);
+	printf("ring       size   put MB/s put ns/msg get MB/s get ns/msg\n");
+	for (int s = 0; s < 3; s++) {
+		run("ringbuf", sizes[s], rb);
+		run("original", sizes[s], NULL);
+	}
+
+	ringbuf_destroy(rb);
+	return 0;
+}
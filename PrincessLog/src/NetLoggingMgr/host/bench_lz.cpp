@@ -0,0 +1,161 @@
+/*
+PSVita RE Tools: NetLoggingMgr aka PrincessLog
+Copyright (C) 2020 Asakura Reiko
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern "C" {
+#include "bench.h"
+#include "lz.h"
+}
+
+/*
+ * The module's compressor against NetDbgLogPc's decompressor, in the
+ * 8 KB blocks net_thread compresses. Input is the files given on the
+ * command line, or else a generated log in the shape of a kernel log:
+ * module prefixes, thread and pid numbers, addresses and counters. C++
+ * only because the decompressor is NetDbgLogPc code; both lz.h have the
+ * same guard, so its one function is declared here.
+ */
+#define BLOCK 0x2000
+#define GEN_BYTES (4 << 20)
+#define RUN_NS 1000000000ULL
+
+int lz_decompress(const char *src, int src_len, char *dst, int dst_size);
+
+static char *gen_log(size_t *len) {
+	static const char *const fmt[] = {
+		"[NetLoggingMgr] net_thread connected to %u.%u.%u.%u:%u\n",
+		"[SceShell] app launch titleid=NPXS%05u pid=0x%08X\n",
+		"[SceAppMgr] sceAppMgrLaunchAppByPath: ux0:app/VITASHELL/eboot.bin ret=0x%08X\n",
+		"[SceKernelModulemgr] module_start: 0x%08X size=%u flags=0x%X\n",
+		"[taiHEN] hooking import 0x%08X in pid 0x%08X: %d\n",
+		"[SceNetPs] recv timeout on sock %u after %u us\n",
+		"[SceIofilemgr] open ux0:data/savedata/%u.bin mode 0x%X fd 0x%08X\n",
+		"[VitaShell] frame %u took %u us, %u draws\n",
+	};
+	char *buf = (char *)malloc(GEN_BYTES + 256);
+	unsigned int seed = 1;
+	size_t n = 0;
+
+	while (n < GEN_BYTES) {
+		unsigned int r[5];
+
+		for (int i = 0; i < 5; i++) {
+			seed = seed * 1103515245 + 12345;
+			r[i] = seed >> 8;
+		}
+		// mostly small numbers and a handful of distinct addresses, like a real log
+		n += sprintf(buf + n, fmt[r[0] % 8], r[1] % 256, 0x81000000 + (r[2] % 16) * 0x1000,
+			r[3] % 4096, r[4] % 100000, r[1] % 7);
+	}
+
+	*len = n;
+	return buf;
+}
+
+static void run(const char *name, const char *data, size_t len) {
+	static lz_state lz;
+	static char out[LZ_BOUND(BLOCK)], back[BLOCK];
+	size_t packed = 0;
+	uint64_t t0, c_ns, d_ns;
+	int reps;
+
+	for (size_t off = 0; off < len; off += BLOCK) {
+		unsigned int n = len - off < BLOCK ? len - off : BLOCK;
+		int c = lz_compress(&lz, data + off, n, out, sizeof(out));
+
+		if (c < 0 || lz_decompress(out, c, back, n) != (int)n || memcmp(back, data + off, n) != 0) {
+			printf("%s: block at %zu does not round trip\n", name, off);
+			exit(1);
+		}
+		// the sender falls back to plain frames when a block does not shrink
+		packed += (size_t)c < n ? (size_t)c : n;
+	}
+
+	t0 = bench_now_ns();
+	reps = 0;
+	do {
+		for (size_t off = 0; off < len; off += BLOCK) {
+			unsigned int n = len - off < BLOCK ? len - off : BLOCK;
+
+			lz_compress(&lz, data + off, n, out, sizeof(out));
+		}
+		reps++;
+	} while (bench_now_ns() - t0 < RUN_NS);
+	c_ns = (bench_now_ns() - t0) / reps;
+
+	// decompress one block over and over per position, so only the decoder is timed
+	t0 = bench_now_ns();
+	reps = 0;
+	d_ns = 0;
+	do {
+		for (size_t off = 0; off < len; off += BLOCK) {
+			unsigned int n = len - off < BLOCK ? len - off : BLOCK;
+			int c = lz_compress(&lz, data + off, n, out, sizeof(out));
+			uint64_t t1 = bench_now_ns();
+
+			lz_decompress(out, c, back, n);
+			d_ns += bench_now_ns() - t1;
+		}
+		reps++;
+	} while (bench_now_ns() - t0 < RUN_NS);
+	d_ns /= reps;
+
+	printf("%-24s %9zu %6.1f%% %10.0f %10.0f\n", name, len, 100.0 * packed / len,
+		len / (c_ns / 1e3), len / (d_ns / 1e3));
+}
+
+int main(int argc, char **argv) {
+	printf("%d byte blocks\n", BLOCK);
+	printf("input                        bytes  ratio comp MB/s dec MB/s\n");
+
+	if (argc < 2) {
+		size_t len;
+		char *data = gen_log(&len);
+
+		run("generated kernel log", data, len);
+		free(data);
+	}
+
+	for (int i = 1; i < argc; i++) {
+		FILE *f = fopen(argv[i], "rb");
+		char *data;
+		long len;
+
+		if (f == NULL) {
+			printf("%s: cannot open\n", argv[i]);
+			return 1;
+		}
+		fseek(f, 0, SEEK_END);
+		len = ftell(f);
+		fseek(f, 0, SEEK_SET);
+		data = (char *)malloc(len);
+		if (fread(data, 1, len, f) != (size_t)len) {
+			printf("%s: short read\n", argv[i]);
+			return 1;
+		}
+		fclose(f);
+
+		const char *base = strrchr(argv[i], '/');
+		run(base != NULL ? base + 1 : argv[i], data, len);
+		free(data);
+	}
+
+	return 0;
+}
@@ -0,0 +1,87 @@
+/*
+PSVita RE Tools: NetLoggingMgr aka PrincessLog
+Copyright (C) 2020 Asakura Reiko
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "bench.h"
+#include "ringbuf.h"
+
+/*
+ * Plain against mirrored rings, single thread: put a batch of records,
+ * peek them and gather the spans into a send buffer the way net_thread
+ * hands them to the socket, commit. Sizes are chosen not to divide the
+ * ring so records keep landing across the wrap.
+ */
+#define RING_SIZE 0x10000
+#define RUN_BYTES (256 << 20)	// per row
+#define BATCH_RECS 16
+
+static void run(int size, unsigned int flags) {
+	static char out[BATCH_RECS * 1024];
+	ringbuf_rec rec[BATCH_RECS];
+	char msg[1024];
+	uint64_t bytes = 0, n_msg = 0, n_split = 0, n_span = 0, t0, t;
+	ringbuf *rb = ringbuf_create(RING_SIZE, flags);
+
+	if (rb == NULL) {
+		printf("%5d %-8s unsupported\n", size, flags ? "mirrored" : "plain");
+		return;
+	}
+	memset(msg, 'x', size);
+
+	t0 = bench_now_ns();
+	while (bytes < RUN_BYTES) {
+		unsigned int len = 0, off = 0;
+		int n_rec;
+
+		for (int i = 0; i < BATCH_RECS; i++) {
+			ringbuf_put(rb, msg, size);
+		}
+		n_rec = ringbuf_peek_recs(rb, rec, BATCH_RECS);
+		for (int i = 0; i < n_rec; i++) {
+			for (int j = 0; j < rec[i].n_span; j++) {
+				memcpy(out + off, rec[i].span[j].ptr, rec[i].span[j].len);
+				off += rec[i].span[j].len;
+			}
+			n_split += rec[i].n_span > 1;
+			n_span += rec[i].n_span;
+			len += rec[i].len;
+		}
+		ringbuf_commit(rb, len);
+		n_msg += n_rec;
+		bytes += len;
+	}
+
+	t = bench_now_ns() - t0;
+	printf("%5d %-8s %9.1f %8.1f %10.2f %10.3f\n", size, flags ? "mirrored" : "plain",
+		bytes / (t / 1e3), (double)t / n_msg,
+		1000.0 * n_split / n_msg, (double)n_span / n_msg);
+	ringbuf_destroy(rb);
+}
+
+int main(void) {
+	static const int sizes[] = { 40, 200, 1000 };
+
+	printf("%d byte ring, %d records per batch, %d MB per row\n", RING_SIZE, BATCH_RECS, RUN_BYTES >> 20);
+	printf(" size ring          MB/s   ns/msg split/1000 spans/rec\n");
+	for (int s = 0; s < 3; s++) {
+		run(sizes[s], 0);
+		run(sizes[s], RINGBUF_FLAG_MIRRORED);
+	}
+
+	return 0;
+}
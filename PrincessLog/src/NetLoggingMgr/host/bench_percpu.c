@@ -0,0 +1,144 @@
+/*
+PSVita RE Tools: NetLoggingMgr aka PrincessLog
+Copyright (C) 2020 Asakura Reiko
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "bench.h"
+#include "ringbuf.h"
+
+/*
+ * Contention between producers pinned to different CPUs. Built twice:
+ * bench_percpu with the per-CPU rings, bench_percpu_single with the
+ * backend reporting CPU 0 for everyone so all producers share one ring
+ * the way they did before the split. Clobbering puts of small messages,
+ * so the producers never wait for the consumer and the reservation is
+ * what is measured.
+ */
+#define RING_SIZE 0x10000
+#define MSG_SIZE 32
+#define RUN_MSGS 400000		// per row, split between the producers
+#define MAX_PRODUCERS 8
+
+typedef struct producer {
+	pthread_t thread;
+	ringbuf *rb;
+	int cpu;
+	int n_msg;
+	uint32_t *lat;
+} producer;
+
+static pthread_barrier_t start;
+static volatile int stop;
+
+static void *producer_main(void *arg) {
+	producer *p = arg;
+	char msg[MSG_SIZE];
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(p->cpu, &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	memset(msg, 'x', sizeof(msg));
+	pthread_barrier_wait(&start);
+
+	for (int i = 0; i < p->n_msg; i++) {
+		uint64_t t0 = bench_now_ns();
+
+		ringbuf_put_clobber(p->rb, msg, sizeof(msg));
+		p->lat[i] = bench_now_ns() - t0;
+	}
+
+	return NULL;
+}
+
+static void *consumer_main(void *arg) {
+	ringbuf *rb = arg;
+	ringbuf_rec rec[64];
+
+	while (!stop) {
+		SceUInt timeout = 1000;
+		unsigned int len = 0;
+		int n_rec;
+
+		ringbuf_wait(rb, &timeout);
+		n_rec = ringbuf_peek_recs(rb, rec, 64);
+		for (int i = 0; i < n_rec; i++) {
+			len += rec[i].len;
+		}
+		ringbuf_commit(rb, len);
+	}
+
+	return NULL;
+}
+
+static void run(int n_prod, int n_cpu) {
+	static const double p[3] = { 0.50, 0.99, 0.999 };
+	static uint32_t lat[RUN_MSGS];
+	producer prod[MAX_PRODUCERS];
+	pthread_t cons;
+	uint32_t pct[3];
+	uint64_t t0, t1;
+	int n_msg = RUN_MSGS / n_prod;
+	ringbuf *rb = ringbuf_create(RING_SIZE, 0);
+
+	ringbuf_set_wakeup(rb, RING_SIZE / 4, 1000);
+	stop = 0;
+	pthread_barrier_init(&start, NULL, n_prod + 1);
+	pthread_create(&cons, NULL, consumer_main, rb);
+	for (int i = 0; i < n_prod; i++) {
+		prod[i] = (producer){ .rb = rb, .cpu = i % n_cpu, .n_msg = n_msg, .lat = &lat[i * n_msg] };
+		pthread_create(&prod[i].thread, NULL, producer_main, &prod[i]);
+	}
+
+	pthread_barrier_wait(&start);
+	t0 = bench_now_ns();
+	for (int i = 0; i < n_prod; i++) {
+		pthread_join(prod[i].thread, NULL);
+	}
+	t1 = bench_now_ns();
+	stop = 1;
+	pthread_join(cons, NULL);
+
+	ringbuf_destroy(rb);
+	pthread_barrier_destroy(&start);
+
+	bench_percentiles(lat, (size_t)n_msg * n_prod, p, pct, 3);
+	printf("%4d %4d %9.2f %7u %7u %8u\n", n_prod, n_prod < n_cpu ? n_prod : n_cpu,
+		(double)n_msg * n_prod / ((t1 - t0) / 1e3), pct[0], pct[1], pct[2]);
+}
+
+int main(void) {
+	static const int prods[] = { 1, 2, 4, 8 };
+	int n_cpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+#ifdef RINGBUF_OS_SINGLE_RING
+	printf("one shared ring, ");
+#else
+	printf("per-CPU rings, ");
+#endif
+	printf("%d byte clobbering puts, %d CPUs online\n", MSG_SIZE, n_cpu);
+	printf("prod cpus Mputs/s  p50 ns  p99 ns p99.9 ns\n");
+	for (int i = 0; i < 4; i++) {
+		run(prods[i], n_cpu);
+	}
+
+	return 0;
+}
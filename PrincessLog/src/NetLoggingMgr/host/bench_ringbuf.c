@@ -0,0 +1,213 @@
+/*
+PSVita RE Tools: NetLoggingMgr aka PrincessLog
+Copyright (C) 2020 Asakura Reiko
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "bench.h"
+#include "ringbuf.h"
+
+/*
+ * Put latency and throughput with 1 to 8 producers and one consumer
+ * draining with peek/commit the way net_thread does, for each message
+ * size and put flavour. Then the time from a put into an idle ring to
+ * the consumer running.
+ */
+#define RING_SIZE 0x10000
+#define RUN_MSGS 200000		// per row, split between the producers
+#define MAX_PRODUCERS 8
+#define WAKE_SAMPLES 2000
+#define WAKE_GAP_NS 200000
+
+enum { MODE_DROP, MODE_CLOBBER, MODE_WAIT, MODE_COUNT };
+static const char *mode_name[MODE_COUNT] = { "drop", "clobber", "wait" };
+
+typedef struct producer {
+	pthread_t thread;
+	ringbuf *rb;
+	int mode;
+	int size;
+	int n_msg;
+	uint32_t *lat;		// ns per put
+} producer;
+
+typedef struct consumer {
+	pthread_t thread;
+	ringbuf *rb;
+	volatile int stop;
+	uint64_t recs;
+	uint64_t bytes;
+	uint32_t *wake;		// us from put to the consumer seeing it, NULL if not measured
+	int n_wake;
+} consumer;
+
+static pthread_barrier_t start;
+
+static void *producer_main(void *arg) {
+	producer *p = arg;
+	char msg[1024];
+
+	memset(msg, 'x', p->size);
+	pthread_barrier_wait(&start);
+
+	for (int i = 0; i < p->n_msg; i++) {
+		uint64_t t0 = bench_now_ns();
+
+		switch (p->mode) {
+		case MODE_DROP:
+			ringbuf_put(p->rb, msg, p->size);
+			break;
+		case MODE_CLOBBER:
+			ringbuf_put_clobber(p->rb, msg, p->size);
+			break;
+		case MODE_WAIT:
+			ringbuf_put_wait(p->rb, msg, p->size, 1000000);
+			break;
+		}
+		p->lat[i] = bench_now_ns() - t0;
+	}
+
+	return NULL;
+}
+
+static void *consumer_main(void *arg) {
+	consumer *c = arg;
+	ringbuf_rec rec[64];
+
+	for (;;) {
+		SceUInt timeout = 1000;
+		unsigned int len = 0;
+		int n_rec;
+
+		ringbuf_wait(c->rb, &timeout);
+		n_rec = ringbuf_peek_recs(c->rb, rec, 64);
+		if (n_rec == 0) {
+			if (c->stop) {
+				break;
+			}
+			continue;
+		}
+
+		for (int i = 0; i < n_rec; i++) {
+			if (c->wake != NULL && !rec[i].marker && c->n_wake < WAKE_SAMPLES) {
+				uint64_t put_ns;
+
+				memcpy(&put_ns, rec[i].span[0].ptr, sizeof(put_ns));
+				c->wake[c->n_wake++] = (bench_now_ns() - put_ns) / 1000;
+			}
+			if (!rec[i].marker) {
+				c->recs++;
+				c->bytes += rec[i].len;
+			}
+			len += rec[i].len;
+		}
+		ringbuf_commit(c->rb, len);
+	}
+
+	return NULL;
+}
+
+static void run(int n_prod, int size, int mode) {
+	static const double p[3] = { 0.50, 0.99, 0.999 };
+	static uint32_t lat[RUN_MSGS];
+	producer prod[MAX_PRODUCERS];
+	consumer cons = { 0 };
+	uint32_t pct[3];
+	uint64_t t0, t1;
+	int n_msg = RUN_MSGS / n_prod;
+
+	cons.rb = ringbuf_create(RING_SIZE, 0);
+	ringbuf_set_wakeup(cons.rb, 1, 0);
+	pthread_barrier_init(&start, NULL, n_prod + 1);
+
+	pthread_create(&cons.thread, NULL, consumer_main, &cons);
+	for (int i = 0; i < n_prod; i++) {
+		prod[i] = (producer){ .rb = cons.rb, .mode = mode, .size = size, .n_msg = n_msg, .lat = &lat[i * n_msg] };
+		pthread_create(&prod[i].thread, NULL, producer_main, &prod[i]);
+	}
+
+	pthread_barrier_wait(&start);
+	t0 = bench_now_ns();
+	for (int i = 0; i < n_prod; i++) {
+		pthread_join(prod[i].thread, NULL);
+	}
+	t1 = bench_now_ns();
+	cons.stop = 1;
+	pthread_join(cons.thread, NULL);
+
+	ringbuf_destroy(cons.rb);
+	pthread_barrier_destroy(&start);
+
+	bench_percentiles(lat, (size_t)n_msg * n_prod, p, pct, 3);
+	printf("%4d %5d %-8s %9.1f %8.1f %7u %7u %8u %7.1f%%\n",
+		n_prod, size, mode_name[mode],
+		(double)n_msg * n_prod * size / ((t1 - t0) / 1e3),
+		(double)(t1 - t0) / ((double)n_msg * n_prod),
+		pct[0], pct[1], pct[2],
+		100.0 * cons.recs / ((double)n_msg * n_prod));
+}
+
+static void run_wake(void) {
+	static const double p[3] = { 0.50, 0.99, 0.999 };
+	static uint32_t wake[WAKE_SAMPLES];
+	consumer cons = { .wake = wake };
+	uint32_t pct[3];
+
+	cons.rb = ringbuf_create(RING_SIZE, 0);
+	ringbuf_set_wakeup(cons.rb, 1, 0);
+	pthread_create(&cons.thread, NULL, consumer_main, &cons);
+
+	for (int i = 0; i < WAKE_SAMPLES; i++) {
+		struct timespec gap = { 0, WAKE_GAP_NS };
+		char msg[16] = { 0 };
+		uint64_t now;
+
+		// spaced out so the consumer is asleep each time
+		nanosleep(&gap, NULL);
+		now = bench_now_ns();
+		memcpy(msg, &now, sizeof(now));
+		ringbuf_put(cons.rb, msg, sizeof(msg));
+	}
+
+	cons.stop = 1;
+	pthread_join(cons.thread, NULL);
+	ringbuf_destroy(cons.rb);
+
+	bench_percentiles(wake, cons.n_wake, p, pct, 3);
+	printf("wake latency over %d puts into an idle ring: p50 %u us, p99 %u us, p99.9 %u us\n",
+		cons.n_wake, pct[0], pct[1], pct[2]);
+}
+
+int main(void) {
+	static const int prods[] = { 1, 2, 4, 8 };
+	static const int sizes[] = { 16, 128, 1024 };
+
+	printf("%d byte rings, %d messages per row, %ld CPUs online\n",
+		RING_SIZE, RUN_MSGS, sysconf(_SC_NPROCESSORS_ONLN));
+	printf("prod  size mode          MB/s   ns/msg  p50 ns  p99 ns p99.9 ns    taken\n");
+	for (int m = 0; m < MODE_COUNT; m++) {
+		for (int s = 0; s < 3; s++) {
+			for (int i = 0; i < 4; i++) {
+				run(prods[i], sizes[s], m);
+			}
+		}
+	}
+
+	run_wake();
+	return 0;
+}
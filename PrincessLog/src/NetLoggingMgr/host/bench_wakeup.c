@@ -0,0 +1,129 @@
+/*
+PSVita RE Tools: NetLoggingMgr aka PrincessLog
+Copyright (C) 2020 Asakura Reiko
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include "bench.h"
+#include "ringbuf.h"
+
+/*
+ * Wakeups and sends at a fixed log rate for different wakeup settings.
+ * One producer puts a record at a steady pace, the consumer loops like
+ * net_thread: wait, peek, one send per MTU worth of data, commit. Puts
+ * that woke the consumer are event flag sets, a syscall each on the Vita.
+ */
+#define RING_SIZE 0x10000
+#define MSG_SIZE 96
+#define MSG_RATE 5000		// per second
+#define RUN_MS 1000
+#define PACKET_MAX 1460
+
+typedef struct consumer {
+	pthread_t thread;
+	ringbuf *rb;
+	volatile int stop;
+	unsigned int wakes;	// times the wait returned with data
+	unsigned int packets;
+	uint64_t bytes;
+	uint64_t delay_us;	// put to peek, summed over records
+	unsigned int recs;
+} consumer;
+
+static void *consumer_main(void *arg) {
+	consumer *c = arg;
+	ringbuf_rec rec[64];
+
+	while (!c->stop) {
+		SceUInt timeout = 100000;
+		unsigned int len = 0;
+		SceUInt64 now;
+		int n_rec;
+
+		if (!ringbuf_wait(c->rb, &timeout)) {
+			continue;
+		}
+		n_rec = ringbuf_peek_recs(c->rb, rec, 64);
+		if (n_rec == 0) {
+			continue;
+		}
+
+		now = os_time_us();
+		c->wakes++;
+		for (int i = 0; i < n_rec; i++) {
+			len += rec[i].len;
+			c->delay_us += now - rec[i].time;
+		}
+		c->recs += n_rec;
+		c->packets += (len + PACKET_MAX - 1) / PACKET_MAX;
+		c->bytes += len;
+		ringbuf_commit(c->rb, len);
+	}
+
+	return NULL;
+}
+
+static void run(unsigned int watermark, SceUInt latency) {
+	consumer cons = { 0 };
+	ringbuf_stats stats;
+	struct timespec due;
+	char msg[MSG_SIZE];
+	int n_msg = MSG_RATE * RUN_MS / 1000;
+
+	memset(msg, 'x', sizeof(msg));
+	cons.rb = ringbuf_create(RING_SIZE, 0);
+	ringbuf_set_wakeup(cons.rb, watermark, latency);
+	pthread_create(&cons.thread, NULL, consumer_main, &cons);
+
+	clock_gettime(CLOCK_MONOTONIC, &due);
+	for (int i = 0; i < n_msg; i++) {
+		due.tv_nsec += 1000000000 / MSG_RATE;
+		if (due.tv_nsec >= 1000000000) {
+			due.tv_sec++;
+			due.tv_nsec -= 1000000000;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+		ringbuf_put(cons.rb, msg, sizeof(msg));
+	}
+
+	// let the last partial batch go out on its deadline
+	due.tv_sec++;
+	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+	cons.stop = 1;
+	ringbuf_wake(cons.rb);
+	pthread_join(cons.thread, NULL);
+
+	ringbuf_get_stats(cons.rb, &stats);
+	ringbuf_destroy(cons.rb);
+
+	printf("%9u %7u %9u %9u %9u %9.0f %9.0f\n", watermark, latency,
+		stats.wakeups, cons.wakes, cons.packets,
+		cons.packets ? (double)cons.bytes / cons.packets : 0.0,
+		cons.recs ? (double)cons.delay_us / cons.recs : 0.0);
+}
+
+int main(void) {
+	printf("%d byte records at %d/s for %d ms (%d KB/s)\n", MSG_SIZE, MSG_RATE, RUN_MS, MSG_SIZE * MSG_RATE / 1000);
+	printf("watermark latency  evf sets     wakes   packets  B/packet delay us\n");
+	// the first is waking on every put, as before the watermark
+	run(1, 0);
+	run(PACKET_MAX, 2000);
+	run(PACKET_MAX, 10000);
+	run(8 * PACKET_MAX, 10000);
+	run(8 * PACKET_MAX, 50000);
+	return 0;
+}
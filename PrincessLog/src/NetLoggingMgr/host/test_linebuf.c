@@ -0,0 +1,182 @@
+/*
+PSVita RE Tools: NetLoggingMgr aka PrincessLog
+Copyright (C) 2020 Asakura Reiko
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include "linebuf.h"
+#include "linebuf_os.h"
+
+/*
+ * Writers print lines a byte at a time while another thread plays
+ * net_thread and flushes their partial lines. Built with every partial
+ * line due at once, and the flusher yields in the middle of each flush,
+ * so it keeps running into the writers. Each writer's records, in the
+ * order they were put, must make up exactly what it printed, with their
+ * times never going back. There are more writers than slots, so the
+ * record per byte fallback is taken as well.
+ */
+#define N_WRITERS 20		// more than LINEBUF_SLOTS
+#define N_LINES 1500		// per writer
+#define LINE_MAX 400		// some longer than a slot
+#define OUT_MAX (N_LINES * LINE_MAX)
+
+typedef struct writer {
+	pthread_t thread;
+	int idx;
+	SceUID tid;
+	char out[OUT_MAX];	// what its records held, in order
+	unsigned int out_len;
+	SceUInt64 last_time;
+	unsigned int recs;
+} writer;
+
+static writer writers[N_WRITERS];
+static pthread_mutex_t put_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_barrier_t start;
+static SceUID flusher_tid;
+static volatile int stop;
+static int failed;
+
+#define FAIL(...) do { printf(__VA_ARGS__); failed = 1; } while (0)
+
+static unsigned int make_line(int w, int n, char *line) {
+	unsigned int len = sprintf(line, "w%d line %d ", w, n);
+	unsigned int fill = (w * 131 + n * 71) % (LINE_MAX - 32);
+
+	for (unsigned int i = 0; i < fill; i++) {
+		line[len++] = 'a' + (n + i) % 26;
+	}
+	line[len++] = '\n';
+	return len;
+}
+
+static int put(char *c, int size, SceUID pid, SceUID tid, SceUInt64 time) {
+	writer *w = NULL;
+
+	// the owner of the slot being flushed gets to run and wants it back
+	if (os_thread_id() == flusher_tid) {
+		sched_yield();
+	}
+
+	pthread_mutex_lock(&put_lock);
+	for (int i = 0; i < N_WRITERS; i++) {
+		if (writers[i].tid == tid) {
+			w = &writers[i];
+		}
+	}
+	if (w == NULL || pid != os_process_id()) {
+		FAIL("record from unknown thread %d of process %d\n", tid, pid);
+	} else if (w->out_len + size > OUT_MAX) {
+		FAIL("writer %d: more bytes than it printed\n", w->idx);
+	} else {
+		if (time < w->last_time) {
+			FAIL("writer %d: record %u goes back %llu us\n", w->idx, w->recs,
+				(unsigned long long)(w->last_time - time));
+		}
+		w->last_time = time;
+		memcpy(w->out + w->out_len, c, size);
+		w->out_len += size;
+		w->recs++;
+	}
+	pthread_mutex_unlock(&put_lock);
+
+	return size;
+}
+
+static void *writer_main(void *arg) {
+	writer *w = arg;
+	char line[LINE_MAX];
+
+	w->tid = os_thread_id();
+	pthread_barrier_wait(&start);
+
+	for (int n = 0; n < N_LINES; n++) {
+		unsigned int len = make_line(w->idx, n, line);
+
+		for (unsigned int i = 0; i < len; i++) {
+			linebuf_putchar(line[i]);
+			// let the flusher in with a partial line staged
+			if (i % 37 == 36) {
+				sched_yield();
+			}
+		}
+	}
+
+	return NULL;
+}
+
+static void *flusher_main(void *arg) {
+	flusher_tid = os_thread_id();
+	pthread_barrier_wait(&start);
+	while (!stop) {
+		linebuf_flush_stale();
+		sched_yield();
+	}
+	return NULL;
+}
+
+int main(void) {
+	ringbuf *rb = ringbuf_create(0x1000, 0);
+	pthread_t flusher;
+	unsigned long long recs = 0;
+	char line[LINE_MAX];
+
+	linebuf_init(rb, put);
+	pthread_barrier_init(&start, NULL, N_WRITERS + 2);
+	for (int i = 0; i < N_WRITERS; i++) {
+		writers[i].idx = i;
+		pthread_create(&writers[i].thread, NULL, writer_main, &writers[i]);
+	}
+	pthread_create(&flusher, NULL, flusher_main, NULL);
+	pthread_barrier_wait(&start);
+
+	for (int i = 0; i < N_WRITERS; i++) {
+		pthread_join(writers[i].thread, NULL);
+	}
+	stop = 1;
+	pthread_join(flusher, NULL);
+	// every line ended in '\n', nothing may be left staged
+	linebuf_flush_stale();
+
+	for (int i = 0; i < N_WRITERS; i++) {
+		writer *w = &writers[i];
+		unsigned int off = 0;
+
+		for (int n = 0; n < N_LINES; n++) {
+			unsigned int len = make_line(i, n, line);
+
+			if (off + len > w->out_len || memcmp(w->out + off, line, len) != 0) {
+				FAIL("writer %d: line %d is not what it printed\n", i, n);
+				break;
+			}
+			off += len;
+		}
+		if (off != w->out_len) {
+			FAIL("writer %d: %u bytes more than it printed\n", i, w->out_len - off);
+		}
+		recs += w->recs;
+	}
+
+	printf("%d writers, %d lines each: %llu records\n", N_WRITERS, N_LINES, recs);
+	pthread_barrier_destroy(&start);
+	ringbuf_destroy(rb);
+
+	printf(failed ? "FAILED\n" : "ok\n");
+	return failed;
+}
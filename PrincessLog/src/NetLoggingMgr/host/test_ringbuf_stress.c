@@ -0,0 +1,269 @@
+/*
+PSVita RE Tools: NetLoggingMgr aka PrincessLog
+Copyright (C) 2020 Asakura Reiko
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ringbuf.h"
+
+/*
+ * Several producers hammer one ring while a consumer drains it with
+ * peek/commit. Every record carries its producer, sequence number and a
+ * payload derived from both, so a torn or mixed up record fails the check.
+ * Waiting puts must all arrive exactly once; dropping and clobbering puts
+ * must arrive at most once, with the ring's loss counters and its marker
+ * records making up exactly for the rest. Some batches are handed back
+ * with ringbuf_unpeek() instead of committed, and must come again or be
+ * counted as lost like any other record.
+ */
+#define N_PRODUCERS 6
+#define N_MSG 40000		// per producer
+#define MSG_MAX 300
+
+enum { MODE_WAIT, MODE_DROP, MODE_CLOBBER, MODE_COUNT };
+static const char *mode_name[MODE_COUNT] = { "wait", "drop", "clobber" };
+
+typedef struct msg_hdr {
+	uint32_t prod;
+	uint32_t seq;
+	uint32_t len;
+} msg_hdr;
+
+typedef struct producer {
+	pthread_t thread;
+	ringbuf *rb;
+	int mode;
+	uint32_t prod;
+	uint64_t bytes;
+} producer;
+
+static int n_done;		// producers finished putting
+static pthread_barrier_t start;
+static uint8_t seen[N_PRODUCERS][N_MSG];
+static int failed;
+
+#define FAIL(...) do { printf(__VA_ARGS__); failed = 1; } while (0)
+
+static uint8_t pattern(uint32_t prod, uint32_t seq, uint32_t i) {
+	return (uint8_t)(prod * 31 + seq * 7 + i);
+}
+
+static void *producer_main(void *arg) {
+	producer *p = arg;
+	char msg[MSG_MAX];
+	msg_hdr *hdr = (msg_hdr *)msg;
+
+	pthread_barrier_wait(&start);
+
+	for (uint32_t seq = 0; seq < N_MSG; seq++) {
+		uint32_t len = sizeof(*hdr) + (seq * 13 + p->prod * 5) % (MSG_MAX - sizeof(*hdr));
+
+		*hdr = (msg_hdr){ p->prod, seq, len };
+		for (uint32_t i = sizeof(*hdr); i < len; i++) {
+			msg[i] = pattern(p->prod, seq, i);
+		}
+
+		// split in two spans now and then to cover putv as well
+		if (seq % 3 == 0) {
+			ringbuf_span span[2] = { { msg, sizeof(*hdr) }, { msg + sizeof(*hdr), len - sizeof(*hdr) } };
+
+			switch (p->mode) {
+			case MODE_WAIT:
+				if (ringbuf_putv_wait(p->rb, span, 2, 5000000) <= 0) {
+					FAIL("%s: putv_wait gave up\n", mode_name[p->mode]);
+				}
+				break;
+			case MODE_DROP:
+				ringbuf_putv(p->rb, span, 2);
+				break;
+			case MODE_CLOBBER:
+				ringbuf_putv_clobber(p->rb, span, 2);
+				break;
+			}
+		} else {
+			switch (p->mode) {
+			case MODE_WAIT:
+				if (ringbuf_put_wait(p->rb, msg, len, 5000000) <= 0) {
+					FAIL("%s: put_wait gave up\n", mode_name[p->mode]);
+				}
+				break;
+			case MODE_DROP:
+				ringbuf_put(p->rb, msg, len);
+				break;
+			case MODE_CLOBBER:
+				ringbuf_put_clobber(p->rb, msg, len);
+				break;
+			}
+		}
+		p->bytes += len;
+	}
+
+	__atomic_add_fetch(&n_done, 1, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+static void check_rec(const ringbuf_rec *rec, int mode) {
+	char buf[MSG_MAX];
+	unsigned int off = 0;
+	msg_hdr hdr;
+
+	if (rec->len > sizeof(buf) || rec->len < sizeof(hdr)) {
+		FAIL("%s: record of %u bytes\n", mode_name[mode], rec->len);
+		return;
+	}
+	for (int i = 0; i < rec->n_span; i++) {
+		memcpy(buf + off, rec->span[i].ptr, rec->span[i].len);
+		off += rec->span[i].len;
+	}
+	if (off != rec->len) {
+		FAIL("%s: spans hold %u of %u bytes\n", mode_name[mode], off, rec->len);
+		return;
+	}
+
+	memcpy(&hdr, buf, sizeof(hdr));
+	if (hdr.prod >= N_PRODUCERS || hdr.seq >= N_MSG || hdr.len != rec->len) {
+		FAIL("%s: bad header %u/%u/%u in a %u byte record\n", mode_name[mode], hdr.prod, hdr.seq, hdr.len, rec->len);
+		return;
+	}
+	for (uint32_t i = sizeof(hdr); i < hdr.len; i++) {
+		if ((uint8_t)buf[i] != pattern(hdr.prod, hdr.seq, i)) {
+			FAIL("%s: torn record %u/%u at byte %u\n", mode_name[mode], hdr.prod, hdr.seq, i);
+			return;
+		}
+	}
+	if (seen[hdr.prod][hdr.seq]++) {
+		FAIL("%s: record %u/%u seen twice\n", mode_name[mode], hdr.prod, hdr.seq);
+	}
+}
+
+static void run(int mode, int ring_size, unsigned int flags) {
+	producer prod[N_PRODUCERS];
+	ringbuf_stats stats;
+	ringbuf_rec rec[16];
+	ringbuf *rb;
+	uint64_t put = 0, put_bytes = 0, got = 0, got_bytes = 0, marked = 0, marked_bytes = 0;
+	uint64_t n_consumed = 0;
+
+	memset(seen, 0, sizeof(seen));
+	n_done = 0;
+
+	rb = ringbuf_create(ring_size, flags);
+	if (rb == NULL) {
+		FAIL("%s: ringbuf_create failed\n", mode_name[mode]);
+		return;
+	}
+	ringbuf_set_wakeup(rb, 1, 0);
+	pthread_barrier_init(&start, NULL, N_PRODUCERS + 1);
+	for (int i = 0; i < N_PRODUCERS; i++) {
+		prod[i] = (producer){ .rb = rb, .mode = mode, .prod = i };
+		pthread_create(&prod[i].thread, NULL, producer_main, &prod[i]);
+	}
+	pthread_barrier_wait(&start);
+
+	// the consumer, on this thread; it keeps going until producers are done and the ring is dry
+	for (;;) {
+		SceUInt timeout = 1000;
+		unsigned int len = 0;
+		int n_rec, done;
+
+		ringbuf_wait(rb, &timeout);
+		// read before peeking, so an empty peek after the last put ends it
+		done = __atomic_load_n(&n_done, __ATOMIC_ACQUIRE) == N_PRODUCERS;
+		n_rec = ringbuf_peek_recs(rb, rec, 16);
+		if (n_rec == 0) {
+			if (done) {
+				break;
+			}
+			continue;
+		}
+
+		// now and then give the batch back unseen, like a send that never started
+		if (++n_consumed % 7 == 0) {
+			ringbuf_unpeek(rb);
+			continue;
+		}
+
+		for (int i = 0; i < n_rec; i++) {
+			if (rec[i].marker) {
+				marked += rec[i].lost;
+				marked_bytes += rec[i].lost_bytes;
+			} else {
+				check_rec(&rec[i], mode);
+				got++;
+				got_bytes += rec[i].len;
+			}
+			len += rec[i].len;
+		}
+
+		// commit partially now and then, like a short send
+		if (n_consumed % 5 == 0 && len > 1) {
+			ringbuf_commit(rb, len / 2);
+			ringbuf_commit(rb, len - len / 2);
+		} else {
+			ringbuf_commit(rb, len);
+		}
+	}
+
+	for (int i = 0; i < N_PRODUCERS; i++) {
+		pthread_join(prod[i].thread, NULL);
+		put += N_MSG;
+		put_bytes += prod[i].bytes;
+	}
+	pthread_barrier_destroy(&start);
+
+	ringbuf_get_stats(rb, &stats);
+	ringbuf_destroy(rb);
+
+	printf("%-7s %6u byte%s ring: %llu put, %llu received, %u evicted, %u dropped, %llu marked lost\n",
+		mode_name[mode], ring_size, flags & RINGBUF_FLAG_MIRRORED ? " mirrored" : "", (unsigned long long)put, (unsigned long long)got,
+		stats.evicted, stats.dropped, (unsigned long long)marked);
+
+	if (got + stats.evicted + stats.dropped + stats.block_timeouts != put) {
+		FAIL("%s: records do not add up\n", mode_name[mode]);
+	}
+	if (got_bytes + stats.evicted_bytes + stats.dropped_bytes + stats.block_timeout_bytes != put_bytes) {
+		FAIL("%s: bytes do not add up\n", mode_name[mode]);
+	}
+	if (marked != (uint64_t)stats.evicted + stats.dropped + stats.block_timeouts
+		|| marked_bytes != (uint64_t)stats.evicted_bytes + stats.dropped_bytes + stats.block_timeout_bytes) {
+		FAIL("%s: markers report %llu lost, the counters %u\n", mode_name[mode],
+			(unsigned long long)marked, stats.evicted + stats.dropped + stats.block_timeouts);
+	}
+	if (mode == MODE_WAIT && got != put) {
+		FAIL("%s: lost records without a full ring\n", mode_name[mode]);
+	}
+	if (mode != MODE_CLOBBER && stats.evicted != 0) {
+		FAIL("%s: evicted without clobbering\n", mode_name[mode]);
+	}
+	if (stats.pending != 0) {
+		FAIL("%s: %u bytes still pending\n", mode_name[mode], stats.pending);
+	}
+}
+
+int main(void) {
+	for (int mode = 0; mode < MODE_COUNT; mode++) {
+		// a small ring to keep it full, and a big one for the uncontended path
+		run(mode, 0x1000, 0);
+		run(mode, 0x40000, 0);
+		run(mode, 0x1000, RINGBUF_FLAG_MIRRORED);
+	}
+
+	printf(failed ? "FAILED\n" : "ok\n");
+	return failed;
+}
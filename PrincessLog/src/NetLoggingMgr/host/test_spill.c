@@ -0,0 +1,233 @@
+/*
+PSVita RE Tools: NetLoggingMgr aka PrincessLog
+Copyright (C) 2020 Asakura Reiko
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "spill.h"
+
+/*
+ * The spill and replay state machine against real files in a scratch
+ * directory. What is written is a byte stream where every byte is known
+ * from its offset, so a replay can be checked to continue exactly where
+ * the last one stopped, and to start exactly past what rotation lost.
+ */
+#define FILE_MAX 0x100000	// SPILL_FILE_MAX in spill.c
+
+static char dir[64];
+static unsigned long long written;	// stream offset of the next byte spilled
+static unsigned long long replayed;	// stream offset of the next byte expected back
+static int failed;
+
+#define FAIL(...) do { printf(__VA_ARGS__); failed = 1; } while (0)
+
+static char stream_byte(unsigned long long off) {
+	return (char)(off * 7 + off / 251);
+}
+
+// spill len more bytes of the stream, in spans of awkward sizes like the ring's
+static void spill(unsigned int len) {
+	static char chunk[5000];
+
+	while (len > 0) {
+		unsigned int n = len < sizeof(chunk) ? len : sizeof(chunk);
+		unsigned int split = n / 3;
+		ringbuf_span span[2] = { { chunk, split }, { chunk + split, n - split } };
+		int ret;
+
+		for (unsigned int i = 0; i < n; i++) {
+			chunk[i] = stream_byte(written + i);
+		}
+		ret = spill_write(span, 2);
+		if (ret != (int)n) {
+			FAIL("spill_write took %d of %u\n", ret, n);
+			return;
+		}
+		written += n;
+		len -= n;
+	}
+}
+
+// replay up to max bytes, committing in odd sized steps, checking each byte
+static unsigned int replay(unsigned int max) {
+	unsigned int total = 0;
+	const char *ptr;
+	int len;
+
+	while (total < max && (len = spill_peek(&ptr)) > 0) {
+		unsigned int n = len < 777 ? len : 777;
+
+		if (n > max - total) {
+			n = max - total;
+		}
+		for (unsigned int i = 0; i < n; i++) {
+			if (ptr[i] != stream_byte(replayed + i)) {
+				FAIL("replayed byte at %llu is wrong\n", replayed + i);
+				return total;
+			}
+		}
+		spill_commit(n);
+		replayed += n;
+		total += n;
+	}
+
+	return total;
+}
+
+static void check_stats(const char *what, unsigned long long lost) {
+	spill_stats stats;
+
+	spill_get_stats(&stats);
+	if (stats.lost_bytes != lost) {
+		FAIL("%s: %u bytes lost, expected %llu\n", what, stats.lost_bytes, lost);
+	}
+	if (stats.errors != 0) {
+		FAIL("%s: %u errors\n", what, stats.errors);
+	}
+}
+
+static void start(void) {
+	written = replayed = 0;
+	if (spill_init(dir) < 0) {
+		FAIL("spill_init failed\n");
+	}
+}
+
+static void test_roundtrip(void) {
+	start();
+	if (spill_pending()) {
+		FAIL("roundtrip: pending on an empty directory\n");
+	}
+
+	spill(300000);
+	if (!spill_pending()) {
+		FAIL("roundtrip: nothing pending after spilling\n");
+	}
+	replay(~0u);
+	if (replayed != written || spill_pending()) {
+		FAIL("roundtrip: replayed %llu of %llu\n", replayed, written);
+	}
+	check_stats("roundtrip", 0);
+}
+
+// past two file sizes the oldest file is rotated away, and only that is lost
+static void test_rotation(void) {
+	spill_stats stats;
+
+	start();
+	spill(2 * FILE_MAX + 123456);
+	spill_flush();
+
+	spill_get_stats(&stats);
+	if (stats.lost_bytes == 0 || stats.lost_bytes > FILE_MAX + 0x4000) {
+		FAIL("rotation: lost %u bytes\n", stats.lost_bytes);
+	}
+	if (stats.spilled_bytes != written) {
+		FAIL("rotation: spilled %u of %llu\n", stats.spilled_bytes, written);
+	}
+
+	replayed = stats.lost_bytes;
+	replay(~0u);
+	if (replayed != written) {
+		FAIL("rotation: replay ended at %llu of %llu\n", replayed, written);
+	}
+	check_stats("rotation", stats.lost_bytes);
+}
+
+// a replay cut short by the server going away again resumes where it stopped
+static void test_interrupted(void) {
+	start();
+	spill(200000);
+	replay(50001);
+	spill(100000);
+	replay(12345);
+	spill(7);
+	replay(~0u);
+	if (replayed != written || spill_pending()) {
+		FAIL("interrupted: replayed %llu of %llu\n", replayed, written);
+	}
+	check_stats("interrupted", 0);
+}
+
+// files left behind are picked up by the next spill_init(), as after a reboot
+static void test_reboot(void) {
+	unsigned long long total;
+
+	start();
+	spill(150000);
+	spill_flush();
+	total = written;
+
+	if (spill_init(dir) < 0 || !spill_pending()) {
+		FAIL("reboot: spilled data not picked up\n");
+	}
+	replay(~0u);
+	if (replayed != total) {
+		FAIL("reboot: replayed %llu of %llu\n", replayed, total);
+	}
+	check_stats("reboot", 0);
+}
+
+// with nowhere to write, spill_write() takes what fits in memory and then fails
+static void test_no_storage(void) {
+	ringbuf_span span = { "x", 1 };
+	spill_stats stats;
+	char missing[80];
+	int total = 0, ret;
+
+	snprintf(missing, sizeof(missing), "%s/missing", dir);
+	if (spill_init(missing) < 0) {
+		FAIL("no storage: spill_init failed\n");
+		return;
+	}
+	while ((ret = spill_write(&span, 1)) > 0 && total < 0x100000) {
+		total += ret;
+	}
+	spill_get_stats(&stats);
+	if (ret >= 0 || stats.errors == 0) {
+		FAIL("no storage: took %d bytes without complaint\n", total);
+	}
+}
+
+int main(void) {
+	const char *tmp = getenv("TMPDIR");
+
+	snprintf(dir, sizeof(dir), "%s/spillXXXXXX", tmp != NULL ? tmp : "/tmp");
+	if (mkdtemp(dir) == NULL) {
+		printf("cannot make a scratch directory\n");
+		return 1;
+	}
+
+	test_roundtrip();
+	test_rotation();
+	test_interrupted();
+	test_reboot();
+	test_no_storage();
+
+	// whatever a failed test left behind
+	for (int i = 0; i < 2; i++) {
+		char path[128];
+
+		snprintf(path, sizeof(path), "%s/NetLoggingMgrSpill.%s", dir, i ? "old" : "bin");
+		unlink(path);
+	}
+	rmdir(dir);
+
+	printf(failed ? "FAILED\n" : "ok\n");
+	return failed;
+}
@@ -8,8 +8,18 @@
 
 #include "NetLoggingMgrInternal.h"
 
+// the plain calls only copy the first NLM_CONFIG_MIN_SIZE bytes, pass
+// sizeof(NetLoggingMgrConfig_t) to the sized ones for the whole config
 int NetLoggingMgrReadConfig(NetLoggingMgrConfig_t *new_config);
+int NetLoggingMgrReadConfigSized(NetLoggingMgrConfig_t *new_config, unsigned int size);
 
+// returns NLM_CONFIG_RING_BUSY if all but the ring size was applied
 int NetLoggingMgrUpdateConfig(NetLoggingMgrConfig_t *new_config);
+int NetLoggingMgrUpdateConfigSized(NetLoggingMgrConfig_t *new_config, unsigned int size);
+
+int NetLoggingMgrGetStats(NetLoggingMgrStats_t *stats);
+
+// copy up to size of the latest log bytes into buf, returns the length
+int NetLoggingMgrDumpRecent(char *buf, unsigned int size);
 
 #endif
\ No newline at end of file
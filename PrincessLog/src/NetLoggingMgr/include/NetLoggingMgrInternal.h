@@ -6,13 +6,133 @@
 #include <stdarg.h>
 #include <inttypes.h>
 
+// log sources, each with its own backpressure policy
+#define NLM_SOURCE_KERNEL_PRINTF 0
+#define NLM_SOURCE_USER_PUTCHAR 1
+#define NLM_SOURCE_MAX 4
+
+// severity carried with each record
+#define NLM_LEVEL_ERROR 0
+#define NLM_LEVEL_WARN 1
+#define NLM_LEVEL_INFO 2
+#define NLM_LEVEL_DEBUG 3
+
+// what a source does when the ring is full
+#define NLM_POLICY_OVERWRITE_OLDEST 0
+#define NLM_POLICY_DROP_NEWEST 1
+#define NLM_POLICY_BLOCK 2 // wait up to block_timeout, for callers that may sleep
+#define NLM_POLICY_MAX 3
+
+// the server and up to three more destinations, each sent every record
+#define NLM_DEST_MAX 4
+
+typedef struct {
+	uint32_t IPv4; // 0 if unused
+	uint16_t port; // 0 for default
+	uint16_t reserved;
+} NetLoggingMgrDest_t;
+
+// output that is dropped before it is formatted
+#define NLM_FILTER_PID_MAX 8
+#define NLM_FILTER_MODULE_MAX 8
+#define NLM_FILTER_NAME_LEN 28 // as SceKernelModuleInfo.module_name
+
+typedef struct {
+	uint32_t pid[NLM_FILTER_PID_MAX];                       // processes, 0 if unused
+	char module[NLM_FILTER_MODULE_MAX][NLM_FILTER_NAME_LEN]; // kernel modules whose printf is muted, "" if unused
+} NetLoggingMgrFilter_t;
+
 typedef struct {
 	uint32_t magic;
 	uint32_t IPv4;
 	uint32_t flags;
-	uint16_t port
+	uint16_t port;
+	uint32_t ring_size; // per CPU ring size in bytes, 0 for default
+	uint8_t policy[NLM_SOURCE_MAX];
+	uint32_t block_timeout; // us, 0 for default
+	uint32_t wake_watermark; // unsent bytes that wake net_thread, 0 for default
+	uint32_t wake_latency;   // us a record may wait to be batched, 0 for default
+	uint32_t batch_size;     // bytes gathered into one TCP send, 0 for default
+	NetLoggingMgrDest_t dest[NLM_DEST_MAX - 1]; // sent the same as the server, at their own pace
+	NetLoggingMgrFilter_t filter;
 } NetLoggingMgrConfig_t;
 
+// config files written before ring_size was added stop here
+#define NLM_CONFIG_MIN_SIZE 0x10
+
+// NetLoggingMgrUpdateConfig() applied all but the ring size, a resize is still draining
+#define NLM_CONFIG_RING_BUSY 1
+
 #define NLM_CONFIG_FLAGS_BIT_QAF_DEBUG_PRINTF			(1 << 0)
+#define NLM_CONFIG_FLAGS_BIT_SPILL				(1 << 1) // keep logs under ur0:data/ while the server is down
+#define NLM_CONFIG_FLAGS_BIT_DEFERRED_FORMAT			(1 << 2) // kernel printf copies its arguments, net_thread formats them
+#define NLM_CONFIG_FLAGS_BIT_BINARY_WIRE			(1 << 3) // send records as NetLoggingMgrWire.h frames, NetDbgLogPc formats them
+#define NLM_CONFIG_FLAGS_BIT_UDP				(1 << 4) // send datagrams instead of a TCP stream, IPv4 may be broadcast or multicast
+#define NLM_CONFIG_FLAGS_BIT_COMPRESS				(1 << 5) // compress batches of binary frames over TCP
+#define NLM_CONFIG_FLAGS_BIT_TCP_NODELAY			(1 << 6) // each batch goes out at once instead of waiting for Nagle
 #define DEFAULT_PORT 8080
+
+#define DEFAULT_RING_SIZE 0x2000
+#define MIN_RING_SIZE 0x1000
+#define MAX_RING_SIZE 0x40000
+
+#define DEFAULT_BLOCK_TIMEOUT (10 * 1000)
+
+#define DEFAULT_WAKE_WATERMARK 1400 // about one TCP segment
+#define DEFAULT_WAKE_LATENCY (5 * 1000)
+
+#define DEFAULT_BATCH_SIZE 1460 // one TCP segment on Ethernet
+#define MIN_BATCH_SIZE 0x100
+#define MAX_BATCH_SIZE 0x2000
+
+// the flight recorder keeps this many of the latest bytes, sent or not
+#define NLM_RECENT_SIZE 0x4000
+
+typedef struct {
+	uint32_t up;                 // connected now
+	uint32_t pending_bytes;      // in its ring and not sent yet
+	uint64_t lag;                // us the oldest of them has waited, 0 if there are none
+	uint32_t evicted;            // records it lost to newer ones while it fell behind
+	uint32_t evicted_bytes;
+	uint32_t connects;
+	uint32_t disconnects;
+	uint64_t send_bytes;
+} NetLoggingMgrDestStats_t;
+
+typedef struct {
+	uint32_t ring_size;
+	uint32_t hwm;           // highest fill of a ring since the last resize
+	uint64_t time_above_80; // longest time (us) a ring spent above 80% full
+	uint32_t evicted;
+	uint32_t evicted_bytes;
+	uint32_t dropped;
+	uint32_t dropped_bytes;
+	uint32_t blocked;
+	uint32_t block_timeouts;
+	uint32_t block_timeout_bytes;
+	uint64_t block_time;    // total time (us) spent waiting for space
+	uint32_t wakeups;       // times a log write woke net_thread
+	uint32_t spilled_bytes;  // written to storage while the server was down
+	uint32_t replayed_bytes;
+	uint32_t spill_lost_bytes;
+	uint32_t spill_errors;
+	uint32_t connects;
+	uint32_t connect_failures;
+	uint32_t disconnects;        // connections lost after they were up
+	uint32_t connect_time_last;  // us from the attempt to the connection being up
+	uint32_t connect_time_max;
+	uint64_t connect_time_total;
+	uint32_t lz_blocks;          // batches sent as LZ frames
+	uint32_t lz_fallbacks;       // batches that did not get smaller and went out as they were
+	uint64_t lz_in_bytes;        // of frames given to the compressor
+	uint64_t lz_out_bytes;       // that went out for them, compressed or not
+	uint64_t lz_time;            // us spent compressing
+	uint32_t sends;              // ksceNetSend and ksceNetSendto calls that sent something
+	uint64_t send_bytes;
+	uint32_t batches;            // batches that were sent, in whole or in part
+	uint64_t batch_recs;         // and the records in them
+	uint32_t filtered;           // printf calls and user output dropped by the filter
+	uint32_t filter_modules;     // muted modules that were loaded when the filter was set
+	NetLoggingMgrDestStats_t dest[NLM_DEST_MAX]; // the server first, the others by their config slot
+} NetLoggingMgrStats_t;
 #endif
\ No newline at end of file
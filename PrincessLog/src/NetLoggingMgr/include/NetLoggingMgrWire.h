@@ -0,0 +1,93 @@
+#ifndef NET_LOGGING_MGR_WIRE_H
+#define NET_LOGGING_MGR_WIRE_H
+
+#include <stdint.h>
+
+/*
+ * Binary stream from net_thread to NetDbgLogPc, little endian. It starts
+ * with NetLoggingMgrWireHello_t, then frames follow back to back, each a
+ * header and len bytes of body. A stream that does not start with the
+ * magic is plain text.
+ *
+ * Over UDP each datagram is a stream of its own: the hello and whole
+ * frames, or plain text. Only seq and pos carry over between datagrams,
+ * and the first timed frame of each carries them.
+ */
+#define NLM_WIRE_MAGIC "NLMB"
+#define NLM_WIRE_VERSION 5
+
+typedef struct {
+	char magic[4];
+	uint16_t version;
+	uint8_t long_size;	// the sender's long and pointer sizes, as packed in FMT bodies
+	uint8_t ptr_size;
+} NetLoggingMgrWireHello_t;
+
+/*
+ * FMT arguments are packed unaligned in format order: a star width or
+ * precision as 4 bytes, then the value as 4 bytes for int and char,
+ * long_size for l, z and t, 8 for ll, L, q and j, ptr_size for p, NUL
+ * terminated bytes for s, and nothing for %n and %%.
+ */
+#define NLM_WIRE_TYPE_TEXT 0	// body is the text
+#define NLM_WIRE_TYPE_FMT 1	// body is the NUL terminated format, then its packed arguments
+#define NLM_WIRE_TYPE_DICT 2	// body is a uint16_t ID, then the NUL terminated format it stands for
+#define NLM_WIRE_TYPE_FMT_ID 3	// body is a uint16_t ID from an earlier DICT frame, then the packed arguments
+#define NLM_WIRE_TYPE_LOST 4	// no body, the sender lost records before the seq in the header
+#define NLM_WIRE_TYPE_LZ 5	// body is the varint length of the frames it holds, then them as an LZ4 block
+
+// DICT IDs are only good until the connection closes
+
+/*
+ * An LZ frame has no time and decodes to whole frames that are handled as
+ * if they had come on their own, LZ frames among them are not allowed.
+ */
+
+// sources besides NLM_SOURCE_*
+#define NLM_WIRE_SOURCE_SELF 0xFF	// the sender's own lines, like notes about lost records
+
+/*
+ * The frame header only carries what changed since the previous frame of
+ * the stream that had a time:
+ *
+ *   uint8_t type
+ *   uint8_t meta	level in the low bits, NLM_WIRE_META_* flags above
+ *   varint  len	of the body
+ *   varint  time	zigzag encoded difference in us, unless NLM_WIRE_META_NO_TIME
+ *   uint8_t source	if NLM_WIRE_META_SOURCE
+ *   varint  pid	if NLM_WIRE_META_PID
+ *   varint  tid	if NLM_WIRE_META_TID
+ *   varint  seq	if NLM_WIRE_META_SEQ
+ *   varint  pos	if NLM_WIRE_META_SEQ
+ *
+ * A varint is 7 bits per byte, low bits first, with the top bit set on
+ * all but the last byte. Both sides start a connection from a zeroed
+ * NetLoggingMgrWireMeta_t.
+ *
+ * TEXT, FMT and FMT_ID frames are a record each and move seq on by one
+ * and pos by their body length. A timed frame only carries seq and pos
+ * when they are not where the frames before left them, the difference is
+ * what got lost on the way.
+ */
+#define NLM_WIRE_META_LEVEL 0x07
+#define NLM_WIRE_META_SOURCE 0x08
+#define NLM_WIRE_META_PID 0x10
+#define NLM_WIRE_META_TID 0x20
+#define NLM_WIRE_META_NO_TIME 0x40	// replayed from storage: no time, source, pid or tid, they stay as they were
+#define NLM_WIRE_META_SEQ 0x80
+
+#define NLM_WIRE_HDR_MAX (1 + 1 + 3 + 10 + 1 + 5 + 5 + 5 + 10)
+
+typedef struct {
+	uint64_t time;		// us since boot when it was logged
+	uint32_t pid;
+	uint32_t tid;
+	uint8_t source;		// NLM_SOURCE_*
+	uint8_t level;		// NLM_LEVEL_*
+	uint32_t seq;		// records on the connection so far, lost ones included
+	uint64_t pos;		// and their bytes
+} NetLoggingMgrWireMeta_t;
+
+#define NLM_WIRE_FRAME_MAX 0xFFFF	// header included
+
+#endif
@@ -0,0 +1,193 @@
+/*
+PSVita RE Tools: NetLoggingMgr aka PrincessLog
+Copyright (C) 2020 Asakura Reiko
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "filter.h"
+#include "ringbuf_os.h"
+#include <psp2kern/kernel/threadmgr.h>
+#include <stddef.h>
+
+/*
+ * Output from muted processes and kernel modules is dropped before it is
+ * formatted or put anywhere. A kernel printf is told apart by its format
+ * string, which lives in the module that printed it.
+ *
+ * Each check is one bit first: pids by hash, addresses by 64KB block.
+ * Only a set bit leads to the exact compare, so output that is not muted,
+ * which is nearly all of it, costs a load and a test or two.
+ *
+ * filter_update() fills the table not in use and then switches to it.
+ * Readers count themselves in on the table they use, so an update waits
+ * for the last of them before it refills a table. The counts are per CPU,
+ * so filtered calls on different cores do not share a cache line. A
+ * reader leaves on the count it entered on, even if it moved since.
+ * Updates are serialized, so two of them do not fill the same table.
+ */
+#define FILTER_PID_MAX 16
+#define FILTER_PID_BITS 8
+#define FILTER_ADDR_SHIFT 16
+#define FILTER_ADDR_BITS (32 - FILTER_ADDR_SHIFT)
+#define FILTER_WAIT_US 100
+#define FILTER_NCPU 4		// as the rings
+#define FILTER_CACHE_LINE 64
+
+void *memset(void *dst, int ch, size_t n);
+
+typedef struct filter_table {
+	uint32_t pid_map[(1 << FILTER_PID_BITS) / 32];
+	uint32_t addr_map[(1 << FILTER_ADDR_BITS) / 32];
+	SceUID pid[FILTER_PID_MAX];
+	int n_pid;
+	filter_range range[FILTER_RANGE_MAX];
+	int n_range;
+} filter_table;
+
+static filter_table tables[2];
+static filter_table *cur = NULL;	// NULL while nothing is muted
+
+// filter_drop() calls in each table, kept out of the memset
+typedef struct filter_readers {
+	int n[2];
+} __attribute__((aligned(FILTER_CACHE_LINE))) filter_readers;
+
+static filter_readers readers[FILTER_NCPU];
+static int updating;
+
+static filter_stats stats;
+
+static unsigned int pid_hash(SceUID pid) {
+	return ((uint32_t)pid * 2654435761u) >> (32 - FILTER_PID_BITS);
+}
+
+static void map_set(uint32_t *map, unsigned int bit) {
+	map[bit >> 5] |= 1u << (bit & 31);
+}
+
+static int map_test(const uint32_t *map, unsigned int bit) {
+	return (map[bit >> 5] >> (bit & 31)) & 1;
+}
+
+static int readers_in(int idx) {
+	int n = 0;
+
+	for (int i = 0; i < FILTER_NCPU; i++) {
+		n += __atomic_load_n(&readers[i].n[idx], __ATOMIC_SEQ_CST);
+	}
+	return n;
+}
+
+void filter_update(const uint32_t *pid, int n_pid, const filter_range *range, int n_range) {
+	filter_table *t;
+	int idx;
+
+	while (__atomic_exchange_n(&updating, 1, __ATOMIC_ACQUIRE)) {
+		ksceKernelDelayThread(FILTER_WAIT_US);
+	}
+
+	idx = __atomic_load_n(&cur, __ATOMIC_RELAXED) == &tables[0];
+	t = &tables[idx];
+
+	// cur is elsewhere, so whoever is still in t got there before the switch
+	while (readers_in(idx) != 0) {
+		ksceKernelDelayThread(FILTER_WAIT_US);
+	}
+
+	memset(t, 0, sizeof(*t));
+
+	for (int i = 0; i < n_pid && t->n_pid < FILTER_PID_MAX; i++) {
+		if (pid[i] == 0) {
+			continue;
+		}
+		t->pid[t->n_pid++] = pid[i];
+		map_set(t->pid_map, pid_hash(pid[i]));
+	}
+
+	for (int i = 0; i < n_range && t->n_range < FILTER_RANGE_MAX; i++) {
+		if (range[i].end <= range[i].start) {
+			continue;
+		}
+		t->range[t->n_range++] = range[i];
+		for (uintptr_t b = range[i].start >> FILTER_ADDR_SHIFT; b <= (range[i].end - 1) >> FILTER_ADDR_SHIFT; b++) {
+			map_set(t->addr_map, b);
+		}
+	}
+
+	__atomic_store_n(&cur, t->n_pid > 0 || t->n_range > 0 ? t : NULL, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&updating, 0, __ATOMIC_RELEASE);
+}
+
+// the table in use, counted in on *count until leave(); NULL while nothing is muted
+static const filter_table *enter(int **count) {
+	filter_readers *r = &readers[os_cpu_id() & (FILTER_NCPU - 1)];
+
+	for (;;) {
+		const filter_table *t = __atomic_load_n(&cur, __ATOMIC_ACQUIRE);
+
+		if (t == NULL) {
+			return NULL;
+		}
+		*count = &r->n[t == &tables[1]];
+		__atomic_add_fetch(*count, 1, __ATOMIC_SEQ_CST);
+		// pairs with filter_update(): still current, so it waits for us
+		if (__atomic_load_n(&cur, __ATOMIC_SEQ_CST) == t) {
+			return t;
+		}
+		__atomic_sub_fetch(*count, 1, __ATOMIC_RELEASE);
+	}
+}
+
+static void leave(int *count) {
+	__atomic_sub_fetch(count, 1, __ATOMIC_RELEASE);
+}
+
+int filter_drop(SceUID pid, const void *addr) {
+	uintptr_t a = (uintptr_t)addr;
+	const filter_table *t;
+	int *count;
+
+	t = enter(&count);
+	if (t == NULL) {
+		return 0;
+	}
+
+	if (map_test(t->pid_map, pid_hash(pid))) {
+		for (int i = 0; i < t->n_pid; i++) {
+			if (t->pid[i] == pid) {
+				goto drop;
+			}
+		}
+	}
+
+	if (addr != NULL && map_test(t->addr_map, a >> FILTER_ADDR_SHIFT)) {
+		for (int i = 0; i < t->n_range; i++) {
+			if (a >= t->range[i].start && a < t->range[i].end) {
+				goto drop;
+			}
+		}
+	}
+
+	leave(count);
+	return 0;
+
+drop:
+	leave(count);
+	__atomic_add_fetch(&stats.dropped, 1, __ATOMIC_RELAXED);
+	return 1;
+}
+
+void filter_get_stats(filter_stats *out) {
+	out->dropped = __atomic_load_n(&stats.dropped, __ATOMIC_RELAXED);
+}
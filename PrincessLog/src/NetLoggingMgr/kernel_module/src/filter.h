@@ -0,0 +1,26 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <psp2kern/types.h>
+#include <stdint.h>
+
+// part of a module, start inclusive and end exclusive
+typedef struct filter_range {
+	uintptr_t start;
+	uintptr_t end;
+} filter_range;
+
+#define FILTER_RANGE_MAX 32
+
+void filter_update(const uint32_t *pid, int n_pid, const filter_range *range, int n_range);
+
+// 1 if output of pid, or printed with a format at addr, is to be dropped
+int filter_drop(SceUID pid, const void *addr);
+
+typedef struct filter_stats {
+	unsigned int dropped;		// calls that returned before anything was formatted
+} filter_stats;
+
+void filter_get_stats(filter_stats *stats);
+
+#endif
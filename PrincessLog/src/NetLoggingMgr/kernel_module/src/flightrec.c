@@ -0,0 +1,189 @@
+/*
+PSVita RE Tools: NetLoggingMgr aka PrincessLog
+Copyright (C) 2020 Asakura Reiko
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "flightrec.h"
+
+/*
+ * Every log record is also kept here. Unlike the ring nothing consumes
+ * it: writers just keep overwriting the oldest records, so the last
+ * FLIGHTREC_LEN bytes are still around after a title crashed, whether or
+ * not net_thread sent them. Records are stored as they are and only
+ * turned into text by the snapshot's emit callback.
+ *
+ * Writers reserve space with one atomic add and never wait. Each 8 byte
+ * slot has a tag: pos | 1 while the record starting at pos is written,
+ * pos once it is complete. A snapshot copies committed records while
+ * writers keep going, and keeps a record only if its tags did not change
+ * during the copy.
+ */
+#define FLIGHTREC_MASK (FLIGHTREC_LEN - 1)
+#define FLIGHTREC_REC_ALIGN 8
+#define FLIGHTREC_HDR_LEN 4
+
+#define load_acquire(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define store_release(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+void *memcpy(void *dst, const void *src, size_t n);
+void *memmove(void *dst, const void *src, size_t n);
+
+static char buf[FLIGHTREC_LEN];
+static unsigned int tags[FLIGHTREC_LEN / FLIGHTREC_REC_ALIGN];
+
+static unsigned int reserve_pos;	// free running, next record position
+static int full;			// reserve_pos went past FLIGHTREC_LEN once
+
+static unsigned int rec_len(unsigned int len) {
+	return (FLIGHTREC_HDR_LEN + len + FLIGHTREC_REC_ALIGN - 1) & ~(FLIGHTREC_REC_ALIGN - 1);
+}
+
+static unsigned int *tag(unsigned int pos) {
+	return &tags[(pos & FLIGHTREC_MASK) / FLIGHTREC_REC_ALIGN];
+}
+
+static void stamp(unsigned int pos, unsigned int need, unsigned int value) {
+	for (unsigned int q = pos; q != pos + need; q += FLIGHTREC_REC_ALIGN) {
+		__atomic_store_n(tag(q), value, __ATOMIC_RELAXED);
+	}
+}
+
+static void copy_in(unsigned int pos, const void *src, unsigned int len) {
+	unsigned int off = pos & FLIGHTREC_MASK;
+	unsigned int first = FLIGHTREC_LEN - off;
+
+	if (first >= len) {
+		memcpy(buf + off, src, len);
+	} else {
+		memcpy(buf + off, src, first);
+		memcpy(buf, (const char *)src + first, len - first);
+	}
+}
+
+static void copy_out(void *dst, unsigned int pos, unsigned int len) {
+	unsigned int off = pos & FLIGHTREC_MASK;
+	unsigned int first = FLIGHTREC_LEN - off;
+
+	if (first >= len) {
+		memcpy(dst, buf + off, len);
+	} else {
+		memcpy(dst, buf + off, first);
+		memcpy((char *)dst + first, buf, len - first);
+	}
+}
+
+// one record made of all the src spans, records over FLIGHTREC_REC_MAX are not kept
+void flightrec_put(const ringbuf_span *src, int n_src) {
+	unsigned int len = 0, pos, need, off;
+
+	for (int i = 0; i < n_src; i++) {
+		len += src[i].len;
+	}
+	if (len > FLIGHTREC_REC_MAX) {
+		return;
+	}
+	need = rec_len(len);
+
+	pos = __atomic_fetch_add(&reserve_pos, need, __ATOMIC_ACQ_REL);
+	if (pos + need >= FLIGHTREC_LEN && !load_acquire(&full)) {
+		store_release(&full, 1);
+	}
+
+	// snapshots must see the old records change before their bytes do
+	stamp(pos, need, pos | 1);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	copy_in(pos, &len, FLIGHTREC_HDR_LEN);
+	off = pos + FLIGHTREC_HDR_LEN;
+	for (int i = 0; i < n_src; i++) {
+		copy_in(off, src[i].ptr, src[i].len);
+		off += src[i].len;
+	}
+
+	// a writer stalled for a whole lap may have written over newer records
+	if (load_acquire(&reserve_pos) - pos > FLIGHTREC_LEN) {
+		stamp(pos, need, pos | 1);
+		return;
+	}
+	store_release(tag(pos), pos);
+}
+
+// whether the record at pos stayed the same while it was copied
+static int unchanged(unsigned int pos, unsigned int need) {
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (__atomic_load_n(tag(pos), __ATOMIC_RELAXED) != pos) {
+		return 0;
+	}
+	for (unsigned int q = pos + FLIGHTREC_REC_ALIGN; q != pos + need; q += FLIGHTREC_REC_ALIGN) {
+		if (__atomic_load_n(tag(q), __ATOMIC_RELAXED) != (pos | 1)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Emit the complete records into out as text, oldest first. When it fills
+ * up the oldest text is dropped, so out ends up with the newest size
+ * bytes. Records written or overwritten meanwhile are left out. Returns
+ * the length. Only one snapshot may run at a time.
+ */
+int flightrec_snapshot(char *out, unsigned int size, flightrec_emit emit) {
+	static char rec[FLIGHTREC_REC_MAX];
+	static char text[FLIGHTREC_REC_MAX];
+	unsigned int end = load_acquire(&reserve_pos);
+	unsigned int span = load_acquire(&full) ? FLIGHTREC_LEN : end;
+	unsigned int pos, len, need, text_len;
+	unsigned int n = 0;
+
+	for (pos = end - span; pos != end; ) {
+		if (load_acquire(tag(pos)) != pos) {
+			// written right now or already overwritten, look at the next slot
+			pos += FLIGHTREC_REC_ALIGN;
+			continue;
+		}
+
+		copy_out(&len, pos, FLIGHTREC_HDR_LEN);
+		need = rec_len(len);
+		if (len > FLIGHTREC_REC_MAX || need > end - pos) {
+			pos += FLIGHTREC_REC_ALIGN;
+			continue;
+		}
+
+		copy_out(rec, pos + FLIGHTREC_HDR_LEN, len);
+		if (!unchanged(pos, need)) {
+			pos += FLIGHTREC_REC_ALIGN;
+			continue;
+		}
+		pos += need;
+
+		text_len = emit(text, sizeof(text), rec, len);
+		if (text_len >= size) {
+			memcpy(out, text + text_len - size, size);
+			n = size;
+			continue;
+		}
+		if (text_len > size - n) {
+			unsigned int drop = text_len - (size - n);
+
+			memmove(out, out + drop, n - drop);
+			n -= drop;
+		}
+		memcpy(out + n, text, text_len);
+		n += text_len;
+	}
+
+	return n;
+}
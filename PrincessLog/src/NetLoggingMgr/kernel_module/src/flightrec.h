@@ -0,0 +1,16 @@
+#ifndef FLIGHTREC_H
+#define FLIGHTREC_H
+
+#include "NetLoggingMgrInternal.h"
+#include "ringbuf.h"
+
+#define FLIGHTREC_LEN NLM_RECENT_SIZE
+#define FLIGHTREC_REC_MAX 0x800
+
+// turns a record into at most size bytes of text, returns the length
+typedef int (*flightrec_emit)(char *out, unsigned int size, const char *rec, unsigned int len);
+
+void flightrec_put(const ringbuf_span *src, int n_src);
+int flightrec_snapshot(char *out, unsigned int size, flightrec_emit emit);
+
+#endif
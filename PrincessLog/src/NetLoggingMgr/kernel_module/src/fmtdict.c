@@ -0,0 +1,74 @@
+/*
+PSVita RE Tools: NetLoggingMgr aka PrincessLog
+Copyright (C) 2020 Asakura Reiko
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "fmtdict.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Kernel log lines come from a few hundred format strings at fixed
+ * addresses, so binary frames name them by a small ID. The first frame
+ * using an ID on a connection is preceded by a DICT frame with the
+ * string, after that only the ID goes out. The receiver keeps the
+ * dictionary per connection, so it is reset for each new one.
+ *
+ * The table is open addressed on the pointer, and the slot is the ID.
+ * Formats that find no free slot within FMTDICT_PROBE are sent inline.
+ */
+#define FMTDICT_MASK (FMTDICT_LEN - 1)
+#define FMTDICT_PROBE 8
+
+void *memset(void *dst, int ch, size_t n);
+
+void fmtdict_reset(fmtdict *d) {
+	memset(d->ent, 0, sizeof(d->ent));
+}
+
+static unsigned int hash(const char *fmt) {
+	uint32_t h = (uint32_t)(uintptr_t)fmt;
+
+	// formats are often 4 byte aligned and close together
+	return ((h >> 2) * 2654435761u) >> 16;
+}
+
+// the ID of fmt, added if it is new, or -1 once the table is full
+int fmtdict_lookup(fmtdict *d, const char *fmt) {
+	unsigned int slot = hash(fmt);
+
+	for (int i = 0; i < FMTDICT_PROBE; i++, slot++) {
+		fmtdict_ent *ent = &d->ent[slot & FMTDICT_MASK];
+
+		if (ent->fmt == fmt) {
+			return slot & FMTDICT_MASK;
+		}
+		if (ent->fmt == NULL) {
+			ent->fmt = fmt;
+			ent->sent = 0;
+			return slot & FMTDICT_MASK;
+		}
+	}
+
+	return -1;
+}
+
+int fmtdict_sent(const fmtdict *d, int id) {
+	return d->ent[id].sent;
+}
+
+void fmtdict_set_sent(fmtdict *d, int id) {
+	d->ent[id].sent = 1;
+}
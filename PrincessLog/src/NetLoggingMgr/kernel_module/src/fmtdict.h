@@ -0,0 +1,21 @@
+#ifndef FMTDICT_H
+#define FMTDICT_H
+
+#define FMTDICT_LEN 0x200	// power of two, IDs fit the wire's 16 bits
+
+typedef struct fmtdict_ent {
+	const char *fmt;	// NULL if unused
+	int sent;		// its DICT frame went out on this connection
+} fmtdict_ent;
+
+// format pointer to wire ID, one per connection and only its sender calls in here
+typedef struct fmtdict {
+	fmtdict_ent ent[FMTDICT_LEN];
+} fmtdict;
+
+void fmtdict_reset(fmtdict *d);
+int fmtdict_lookup(fmtdict *d, const char *fmt);
+int fmtdict_sent(const fmtdict *d, int id);
+void fmtdict_set_sent(fmtdict *d, int id);
+
+#endif
@@ -0,0 +1,226 @@
+/*
+PSVita RE Tools: NetLoggingMgr aka PrincessLog
+Copyright (C) 2020 Asakura Reiko
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "linebuf.h"
+#include "linebuf_os.h"
+#include "ringbuf.h"
+
+/*
+ * User printf arrives one character at a time through the putchar
+ * handler. Each thread gets a staging slot that collects a line and puts
+ * it into the ring as one record on '\n', when the slot is full, or once
+ * net_thread finds it older than LINEBUF_FLUSH_US.
+ *
+ * A thread has at most one slot, so its bytes go out in the order they
+ * came. net_thread only locks a slot to flush a line that is due, and
+ * skips it if it is busy. The owner waits out the flush, which is short,
+ * as its staged bytes must go before the next one. Only a thread without
+ * a slot, and none free, falls back to a record per byte.
+ */
+#define LINEBUF_SLOTS 16
+#define LINEBUF_LEN 0x100
+#ifndef LINEBUF_FLUSH_US
+#define LINEBUF_FLUSH_US (20 * 1000)
+#endif
+#define LINEBUF_SPIN 100	// tries on our own slot before sleeping between them
+#define LINEBUF_WAIT_US 10
+
+#define load_acquire(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define store_release(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+typedef struct linebuf {
+	int busy;
+	SceUID owner;			// thread ID, 0 if never used
+	SceUID owner_pid;		// its process, as of the first byte of the line
+	unsigned int len;
+	SceUInt64 first_time;		// when the first byte of the line came in
+	char buf[LINEBUF_LEN];
+} linebuf;
+
+static linebuf slots[LINEBUF_SLOTS];
+
+static ringbuf *rb;
+static int (*put)(char *c, int size, SceUID pid, SceUID tid, SceUInt64 time);
+
+// how long a partial line has waited, 0 if it started after now
+static SceUInt64 line_age(SceUInt64 now, SceUInt64 first) {
+	return now > first ? now - first : 0;
+}
+
+// slots holding a partial line
+static int n_pending;
+// net_thread waits without a timeout, the next partial line must wake it
+static int consumer_idle;
+
+static int trylock(linebuf *lb) {
+	int expect = 0;
+
+	return __atomic_compare_exchange_n(&lb->busy, &expect, 1, 0,
+		__ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+static void unlock(linebuf *lb) {
+	store_release(&lb->busy, 0);
+}
+
+// the record is the owner's even when net_thread puts a stale line
+static void flush(linebuf *lb) {
+	put(lb->buf, lb->len, lb->owner_pid, lb->owner, lb->first_time);
+	store_release(&lb->len, 0);
+	__atomic_sub_fetch(&n_pending, 1, __ATOMIC_SEQ_CST);
+}
+
+// net_thread flushing it, or another thread taking it over while it is empty
+static void lock_own(linebuf *lb) {
+	for (int n = 0; !trylock(lb); n++) {
+		// whoever holds it may have been preempted by us
+		if (n >= LINEBUF_SPIN) {
+			os_delay_us(LINEBUF_WAIT_US);
+		}
+	}
+}
+
+/*
+ * Find the caller's slot, or take over an empty one. Returns the slot
+ * locked, or NULL if the caller has none and every slot is busy or holds
+ * a partial line, so there is nothing of the caller's staged anywhere.
+ */
+static linebuf *acquire(SceUID tid) {
+	linebuf *lb;
+
+	for (int i = 0; i < LINEBUF_SLOTS; i++) {
+		lb = &slots[i];
+		if (load_acquire(&lb->owner) != tid) {
+			continue;
+		}
+		lock_own(lb);
+		if (lb->owner == tid) {
+			return lb;
+		}
+		unlock(lb);
+	}
+
+	// unused slots first, then empty slots of other threads
+	for (int pass = 0; pass < 2; pass++) {
+		for (int i = 0; i < LINEBUF_SLOTS; i++) {
+			lb = &slots[i];
+			if (pass == 0 && load_acquire(&lb->owner) != 0) {
+				continue;
+			}
+			if (load_acquire(&lb->len) != 0 || !trylock(lb)) {
+				continue;
+			}
+			if (lb->len == 0) {
+				store_release(&lb->owner, tid);
+				return lb;
+			}
+			unlock(lb);
+		}
+	}
+
+	return NULL;
+}
+
+// put() is how finished lines go into the ring, rb is woken for partial ones
+void linebuf_init(ringbuf *ring, int (*put_func)(char *c, int size, SceUID pid, SceUID tid, SceUInt64 time)) {
+	rb = ring;
+	put = put_func;
+}
+
+int linebuf_putchar(char c) {
+	SceUID tid = os_thread_id();
+	linebuf *lb = acquire(tid);
+
+	if (lb == NULL) {
+		return put(&c, 1, os_process_id(), tid, os_time_us());
+	}
+
+	if (lb->len == 0) {
+		lb->owner_pid = os_process_id();
+		// read by net_thread without the lock
+		__atomic_store_n(&lb->first_time, os_time_us(), __ATOMIC_RELAXED);
+		__atomic_add_fetch(&n_pending, 1, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&consumer_idle, __ATOMIC_SEQ_CST)) {
+			store_release(&consumer_idle, 0);
+			ringbuf_wake(rb);
+		}
+	}
+	lb->buf[lb->len] = c;
+	store_release(&lb->len, lb->len + 1);
+
+	if (c == '\n' || lb->len == LINEBUF_LEN) {
+		flush(lb);
+	}
+
+	unlock(lb);
+	return 1;
+}
+
+/*
+ * Called by net_thread before it waits for data. Puts partial lines that
+ * are due into the ring and returns the time in us until the next one is
+ * due, or 0 if there is none.
+ */
+SceUInt linebuf_flush_stale(void) {
+	SceUInt64 now;
+	SceUInt next = 0;
+
+	store_release(&consumer_idle, 0);
+
+	if (__atomic_load_n(&n_pending, __ATOMIC_SEQ_CST) == 0) {
+		__atomic_store_n(&consumer_idle, 1, __ATOMIC_SEQ_CST);
+		// pairs with linebuf_putchar(): one of us sees the other
+		if (__atomic_load_n(&n_pending, __ATOMIC_SEQ_CST) == 0) {
+			return 0;
+		}
+		store_release(&consumer_idle, 0);
+	}
+
+	now = os_time_us();
+	for (int i = 0; i < LINEBUF_SLOTS; i++) {
+		linebuf *lb = &slots[i];
+		SceUInt64 age;
+
+		if (load_acquire(&lb->len) == 0) {
+			continue;
+		}
+
+		// a line that is not due is left alone, its owner never waits for it
+		age = line_age(now, __atomic_load_n(&lb->first_time, __ATOMIC_RELAXED));
+		if (age < LINEBUF_FLUSH_US) {
+			if (next == 0 || LINEBUF_FLUSH_US - age < next) {
+				next = LINEBUF_FLUSH_US - age;
+			}
+			continue;
+		}
+
+		if (!trylock(lb)) {
+			continue;
+		}
+		if (lb->len != 0 && line_age(now, lb->first_time) >= LINEBUF_FLUSH_US) {
+			flush(lb);
+		}
+		unlock(lb);
+	}
+
+	// a slot locked by its owner is looked at again soon
+	if (next == 0 && __atomic_load_n(&n_pending, __ATOMIC_SEQ_CST) != 0) {
+		next = LINEBUF_FLUSH_US;
+	}
+
+	return next;
+}
@@ -0,0 +1,11 @@
+#ifndef LINEBUF_H
+#define LINEBUF_H
+
+#include "ringbuf.h"
+
+// put() gets who wrote the line and when it started, it may be called from net_thread
+void linebuf_init(ringbuf *rb, int (*put)(char *c, int size, SceUID pid, SceUID tid, SceUInt64 time));
+int linebuf_putchar(char c);
+SceUInt linebuf_flush_stale(void);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef LINEBUF_OS_H
+#define LINEBUF_OS_H
+
+#include "ringbuf_os.h"
+
+/*
+ * What the line buffers need from the OS besides os_time_us().
+ * linebuf_os_vita.c implements it for the kernel module,
+ * linebuf_os_posix.c so the slots can be tested on a Linux host.
+ */
+
+SceUID os_thread_id(void);
+SceUID os_process_id(void);
+void os_delay_us(SceUInt us);
+
+#endif
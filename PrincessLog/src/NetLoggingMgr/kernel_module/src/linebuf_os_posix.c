@@ -0,0 +1,33 @@
+/*
+PSVita RE Tools: NetLoggingMgr aka PrincessLog
+Copyright (C) 2020 Asakura Reiko
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+#include "linebuf_os.h"
+#include <sys/syscall.h>
+#include <unistd.h>
+
+SceUID os_thread_id(void) {
+	return syscall(SYS_gettid);
+}
+
+SceUID os_process_id(void) {
+	return getpid();
+}
+
+void os_delay_us(SceUInt us) {
+	usleep(us);
+}
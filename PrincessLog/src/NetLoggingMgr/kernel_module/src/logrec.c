@@ -0,0 +1,414 @@
+/*
+PSVita RE Tools: NetLoggingMgr aka PrincessLog
+Copyright (C) 2020 Asakura Reiko
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "logrec.h"
+#include <stddef.h>
+
+/*
+ * Deferred formatting. Instead of running vsnprintf in the thread that
+ * logs, logrec_capture() stores the format pointer followed by the raw
+ * argument words, and logrec_format() produces the text later from that.
+ * String arguments are copied at once since the caller may free or reuse
+ * them; the format string itself is not, so it has to stay mapped until
+ * the record is formatted. That holds while the record is in the ring,
+ * the flight recorder keeps records much longer and stores a copy of the
+ * format instead (FMT_COPY).
+ *
+ * Both walk the format with parse_spec(), so they agree on the layout:
+ * a star width or precision is an int, then the value in its own size,
+ * strings as NUL terminated bytes. Values are unaligned in the payload.
+ */
+#define LOGREC_SPEC_MAX 16	// longest conversion spec, "%-#0*.*llx" and the like
+#define LOGREC_STR_MAX 0x100	// longest string argument copied, longer ones are formatted at once
+
+// what a conversion takes from the argument list
+#define ARG_NONE 0		// "%%"
+#define ARG_INT 1
+#define ARG_LONG 2
+#define ARG_LLONG 3
+#define ARG_PTR 4
+#define ARG_STR 5
+#define ARG_COUNT 6		// "%n", its pointer is skipped and nothing is stored
+
+void *memcpy(void *dst, const void *src, size_t n);
+size_t strnlen(const char *s, size_t maxlen);
+int snprintf(char *s, size_t n, const char *fmt, ...);
+
+typedef struct spec {
+	unsigned int len;	// from '%' up to and including the conversion
+	int arg;
+	int width_star;
+	int prec_star;
+	int prec;		// literal precision, -1 if there is none
+} spec;
+
+/*
+ * Parse the conversion spec starting at p, which points to a '%'. Returns
+ * 0 for anything not captured, floats included, so the caller formats
+ * the message right away instead.
+ */
+static int parse_spec(const char *p, spec *s) {
+	const char *q = p + 1;
+	int n_long = 0;
+
+	s->width_star = 0;
+	s->prec_star = 0;
+	s->prec = -1;
+
+	while (*q == '-' || *q == '+' || *q == ' ' || *q == '#' || *q == '0') {
+		q++;
+	}
+	if (*q == '*') {
+		s->width_star = 1;
+		q++;
+	} else {
+		while (*q >= '0' && *q <= '9') {
+			q++;
+		}
+	}
+	if (*q == '.') {
+		q++;
+		if (*q == '*') {
+			s->prec_star = 1;
+			q++;
+		} else {
+			s->prec = 0;
+			while (*q >= '0' && *q <= '9') {
+				s->prec = s->prec * 10 + (*q - '0');
+				q++;
+			}
+		}
+	}
+
+	switch (*q) {
+	case 'h':
+		q += q[1] == 'h' ? 2 : 1;
+		break;
+	case 'l':
+		n_long = q[1] == 'l' ? 2 : 1;
+		q += n_long;
+		break;
+	case 'L':
+	case 'q':
+	case 'j':
+		n_long = 2;
+		q++;
+		break;
+	case 'z':
+	case 't':
+		n_long = 1;
+		q++;
+		break;
+	}
+
+	switch (*q) {
+	case 'd':
+	case 'i':
+	case 'u':
+	case 'o':
+	case 'x':
+	case 'X':
+		s->arg = n_long == 2 ? ARG_LLONG : n_long ? ARG_LONG : ARG_INT;
+		break;
+	case 'c':
+		s->arg = ARG_INT;
+		break;
+	case 'p':
+		s->arg = ARG_PTR;
+		break;
+	case 's':
+		if (n_long) {
+			return 0;
+		}
+		s->arg = ARG_STR;
+		break;
+	case 'n':
+		s->arg = ARG_COUNT;
+		break;
+	case '%':
+		s->arg = ARG_NONE;
+		break;
+	default:
+		return 0;
+	}
+
+	s->len = q + 1 - p;
+	return s->len < LOGREC_SPEC_MAX;
+}
+
+static int put(char *out, unsigned int size, unsigned int *n, const void *v, unsigned int len) {
+	if (len > size - *n) {
+		return -1;
+	}
+	memcpy(out + *n, v, len);
+	*n += len;
+	return 0;
+}
+
+static int get(const char *in, unsigned int len, unsigned int *n, void *v, unsigned int size) {
+	if (size > len - *n) {
+		return -1;
+	}
+	memcpy(v, in + *n, size);
+	*n += size;
+	return 0;
+}
+
+/*
+ * Capture fmt and its arguments into out as a FMT payload. Returns its
+ * length, or < 0 if it does not fit or fmt has a conversion that is not
+ * captured.
+ */
+int logrec_capture(char *out, unsigned int size, const char *fmt, va_list args) {
+	va_list ap;
+	unsigned int n = 0;
+	int ret = -1;
+	spec s;
+
+#define PUT(v, len) do { if (put(out, size, &n, (v), (len)) < 0) goto end; } while (0)
+
+	// the caller may still want args if this fails
+	va_copy(ap, args);
+
+	PUT(&fmt, sizeof(fmt));
+
+	for (const char *p = fmt; *p != '\0'; ) {
+		int prec;
+
+		if (*p != '%') {
+			p++;
+			continue;
+		}
+		if (!parse_spec(p, &s)) {
+			goto end;
+		}
+		p += s.len;
+
+		prec = s.prec;
+		if (s.width_star) {
+			int width = va_arg(ap, int);
+			PUT(&width, sizeof(width));
+		}
+		if (s.prec_star) {
+			prec = va_arg(ap, int);
+			PUT(&prec, sizeof(prec));
+		}
+
+		switch (s.arg) {
+		case ARG_INT: {
+			unsigned int v = va_arg(ap, unsigned int);
+			PUT(&v, sizeof(v));
+			break;
+		}
+		case ARG_LONG: {
+			unsigned long v = va_arg(ap, unsigned long);
+			PUT(&v, sizeof(v));
+			break;
+		}
+		case ARG_LLONG: {
+			unsigned long long v = va_arg(ap, unsigned long long);
+			PUT(&v, sizeof(v));
+			break;
+		}
+		case ARG_PTR: {
+			void *v = va_arg(ap, void *);
+			PUT(&v, sizeof(v));
+			break;
+		}
+		case ARG_STR: {
+			const char *str = va_arg(ap, const char *);
+			unsigned int max = LOGREC_STR_MAX, len;
+
+			if (str == NULL) {
+				str = "(null)";
+			}
+			// a precision may mean str is not terminated at all, so read no further
+			if (prec >= 0 && (unsigned int)prec <= max) {
+				len = strnlen(str, prec);
+			} else {
+				// one more to tell a string that is too long from one that just fits
+				len = strnlen(str, max + 1);
+				if (len > max) {
+					goto end;
+				}
+			}
+			PUT(str, len);
+			PUT("", 1);
+			break;
+		}
+		case ARG_COUNT:
+			(void)va_arg(ap, void *);
+			break;
+		}
+	}
+
+	ret = n;
+
+#undef PUT
+
+end:
+	va_end(ap);
+	return ret;
+}
+
+// format fmt with the captured arguments that follow the format pointer in payload
+static int format(char *out, unsigned int size, const char *fmt, const char *payload, unsigned int len) {
+	const char *p;
+	char spec_buf[LOGREC_SPEC_MAX];
+	unsigned int in = 0, n = 0;
+	int star[2], n_star, ret;
+	spec s;
+
+	if (size == 0) {
+		return 0;
+	}
+
+#define GET(v, size) do { if (get(payload, len, &in, (v), (size)) < 0) goto end; } while (0)
+#define FORMAT(v) ( \
+	n_star == 0 ? snprintf(out + n, size - n, spec_buf, (v)) : \
+	n_star == 1 ? snprintf(out + n, size - n, spec_buf, star[0], (v)) : \
+	snprintf(out + n, size - n, spec_buf, star[0], star[1], (v)))
+
+	for (p = fmt; *p != '\0' && n < size - 1; ) {
+		if (*p != '%') {
+			out[n++] = *p++;
+			continue;
+		}
+		if (!parse_spec(p, &s)) {
+			break;
+		}
+		memcpy(spec_buf, p, s.len);
+		spec_buf[s.len] = '\0';
+		p += s.len;
+
+		n_star = 0;
+		if (s.width_star) {
+			GET(&star[n_star++], sizeof(int));
+		}
+		if (s.prec_star) {
+			GET(&star[n_star++], sizeof(int));
+		}
+
+		switch (s.arg) {
+		case ARG_NONE:
+			out[n++] = '%';
+			continue;
+		case ARG_INT: {
+			unsigned int v;
+			GET(&v, sizeof(v));
+			ret = FORMAT(v);
+			break;
+		}
+		case ARG_LONG: {
+			unsigned long v;
+			GET(&v, sizeof(v));
+			ret = FORMAT(v);
+			break;
+		}
+		case ARG_LLONG: {
+			unsigned long long v;
+			GET(&v, sizeof(v));
+			ret = FORMAT(v);
+			break;
+		}
+		case ARG_PTR: {
+			void *v;
+			GET(&v, sizeof(v));
+			ret = FORMAT(v);
+			break;
+		}
+		case ARG_STR: {
+			const char *str = payload + in;
+			unsigned int str_len = strnlen(str, len - in);
+
+			if (str_len == len - in) {
+				goto end;
+			}
+			in += str_len + 1;
+			ret = FORMAT(str);
+			break;
+		}
+		default:
+			continue;
+		}
+
+		if (ret < 0) {
+			break;
+		}
+		n += ret;
+		if (n > size - 1) {
+			n = size - 1;
+		}
+	}
+
+#undef FORMAT
+#undef GET
+
+end:
+	out[n] = '\0';
+	return n;
+}
+
+/*
+ * Format a FMT payload into out, truncated like vsnprintf would. Returns
+ * the length of the text, out is NUL terminated.
+ */
+int logrec_format(char *out, unsigned int size, const char *payload, unsigned int len) {
+	const char *fmt;
+
+	if (len < sizeof(fmt)) {
+		if (size > 0) {
+			out[0] = '\0';
+		}
+		return 0;
+	}
+	memcpy(&fmt, payload, sizeof(fmt));
+	return format(out, size, fmt, payload + sizeof(fmt), len - sizeof(fmt));
+}
+
+/*
+ * The text of a whole record, logrec_hdr included, as it would have been
+ * logged without deferred formatting. Returns its length.
+ */
+int logrec_text(char *out, unsigned int size, const char *rec, unsigned int len) {
+	logrec_hdr hdr;
+
+	if (len < sizeof(hdr)) {
+		return 0;
+	}
+	memcpy(&hdr, rec, sizeof(hdr));
+	rec += sizeof(hdr);
+	len -= sizeof(hdr);
+
+	if (hdr.type == LOGREC_TYPE_FMT) {
+		return logrec_format(out, size, rec, len);
+	}
+	if (hdr.type == LOGREC_TYPE_FMT_COPY) {
+		unsigned int fmt_len = strnlen(rec, len);
+
+		if (fmt_len == len) {
+			return 0;
+		}
+		return format(out, size, rec, rec + fmt_len + 1, len - fmt_len - 1);
+	}
+
+	if (len > size) {
+		len = size;
+	}
+	memcpy(out, rec, len);
+	return len;
+}
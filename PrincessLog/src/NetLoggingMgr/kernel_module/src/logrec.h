@@ -0,0 +1,29 @@
+#ifndef LOGREC_H
+#define LOGREC_H
+
+#include <stdarg.h>
+
+// every log record in the ring starts with a logrec_hdr
+#define LOGREC_TYPE_TEXT 0	// the payload is the text itself
+#define LOGREC_TYPE_FMT 1	// the payload is the format pointer and its captured arguments
+#define LOGREC_TYPE_FMT_COPY 2	// the format itself, NUL terminated, then the captured arguments
+
+typedef struct logrec_hdr {
+	unsigned char type;
+	unsigned char source;
+	unsigned char level;
+	unsigned char reserved;
+	int pid;		// who logged it
+	int tid;
+} logrec_hdr;
+
+// longest payload of a FMT record, and longest text one formats to
+#define LOGREC_MAX_LEN 0x400
+// longest format a FMT_COPY record keeps, the rest is cut
+#define LOGREC_FMT_MAX 0x200
+
+int logrec_capture(char *out, unsigned int size, const char *fmt, va_list args);
+int logrec_format(char *out, unsigned int size, const char *payload, unsigned int len);
+int logrec_text(char *out, unsigned int size, const char *rec, unsigned int len);
+
+#endif
@@ -0,0 +1,135 @@
+/*
+PSVita RE Tools: NetLoggingMgr aka PrincessLog
+Copyright (C) 2020 Asakura Reiko
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "lz.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Output is the LZ4 block format, so anything that reads LZ4 blocks can
+ * read it: a run of sequences, each a token byte with the literal count
+ * in the high nibble and the match length minus 4 in the low one, 15
+ * meaning more length bytes follow (255 says keep going), then the
+ * literals, then a 2 byte little endian offset back into the output. The
+ * last sequence is literals only. As the format asks, the last 5 bytes
+ * are always literals and no match starts in the last 12.
+ *
+ * One probe per position into a table of the last position seen for
+ * each 4 byte hash, with no chains and no lazy matching. Log text is
+ * mostly repeated prefixes and format strings, which this finds at a
+ * small fraction of the cost of the network send.
+ */
+#define LZ_MIN_MATCH 4
+#define LZ_LAST_LITERALS 5
+#define LZ_MF_LIMIT 12
+
+void *memcpy(void *dst, const void *src, size_t n);
+void *memset(void *dst, int ch, size_t n);
+
+static uint32_t read32(const uint8_t *p) {
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static unsigned int hash(uint32_t v) {
+	return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static uint8_t *put_len(uint8_t *op, unsigned int len) {
+	for (; len >= 255; len -= 255) {
+		*op++ = 255;
+	}
+	*op++ = len;
+	return op;
+}
+
+// literals and the token for them, op has room for LZ_BOUND of them
+static uint8_t *put_literals(uint8_t *op, const uint8_t *lit, unsigned int n, unsigned int match) {
+	*op++ = (n >= 15 ? 15 : n) << 4 | (match >= 15 ? 15 : match);
+	if (n >= 15) {
+		op = put_len(op, n - 15);
+	}
+	memcpy(op, lit, n);
+	return op + n;
+}
+
+// the compressed length, or -1 if it does not fit dst
+int lz_compress(lz_state *lz, const char *src, unsigned int src_len, char *dst, unsigned int dst_size) {
+	uint16_t *table = lz->table;
+	const uint8_t *base = (const uint8_t *)src;
+	const uint8_t *ip = base;
+	const uint8_t *anchor = base;
+	const uint8_t *end = base + src_len;
+	uint8_t *op = (uint8_t *)dst;
+	uint8_t *oend = op + dst_size;
+	unsigned int n;
+
+	if (src_len > LZ_MAX_IN) {
+		return -1;
+	}
+
+	// a stale entry only costs a compare that fails
+	memset(lz->table, 0, sizeof(lz->table));
+
+	if (src_len > LZ_MF_LIMIT) {
+		const uint8_t *mflimit = end - LZ_MF_LIMIT;
+		const uint8_t *matchlimit = end - LZ_LAST_LITERALS;
+
+		while (ip < mflimit) {
+			uint32_t v = read32(ip);
+			unsigned int h = hash(v);
+			const uint8_t *ref = base + table[h];
+			const uint8_t *mp = ip + LZ_MIN_MATCH;
+			unsigned int off, mlen;
+
+			table[h] = ip - base;
+			if (ref >= ip || read32(ref) != v) {
+				ip++;
+				continue;
+			}
+
+			for (ref += LZ_MIN_MATCH; mp < matchlimit && *mp == *ref; mp++, ref++);
+
+			n = ip - anchor;
+			mlen = mp - ip - LZ_MIN_MATCH;
+			if ((unsigned int)(oend - op) < 1 + n / 255 + 1 + n + 2 + mlen / 255 + 1) {
+				return -1;
+			}
+
+			off = mp - ref;
+			op = put_literals(op, anchor, n, mlen);
+			*op++ = off;
+			*op++ = off >> 8;
+			if (mlen >= 15) {
+				op = put_len(op, mlen - 15);
+			}
+
+			ip = mp;
+			anchor = ip;
+		}
+	}
+
+	n = end - anchor;
+	if ((unsigned int)(oend - op) < 1 + n / 255 + 1 + n) {
+		return -1;
+	}
+	op = put_literals(op, anchor, n, 0);
+
+	return op - (uint8_t *)dst;
+}
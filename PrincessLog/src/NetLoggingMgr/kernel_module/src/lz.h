@@ -0,0 +1,20 @@
+#ifndef LZ_H
+#define LZ_H
+
+// inputs longer than this are refused, positions have to fit the table
+#define LZ_MAX_IN 0xFFFF
+
+// worst case output for n bytes of input
+#define LZ_BOUND(n) ((n) + (n) / 255 + 16)
+
+#define LZ_HASH_BITS 11		// 4KB of table
+
+// match table, one per caller so senders can compress side by side
+typedef struct lz_state {
+	unsigned short table[1 << LZ_HASH_BITS];
+} lz_state;
+
+// block compressor for outbound batches
+int lz_compress(lz_state *lz, const char *src, unsigned int src_len, char *dst, unsigned int dst_size);
+
+#endif
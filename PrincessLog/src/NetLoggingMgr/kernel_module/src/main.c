@@ -32,7 +32,15 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <stdarg.h>
 
 #include "NetLoggingMgrInternal.h"
+#include "NetLoggingMgrWire.h"
 #include "ringbuf.h"
+#include "linebuf.h"
+#include "spill.h"
+#include "flightrec.h"
+#include "logrec.h"
+#include "fmtdict.h"
+#include "lz.h"
+#include "filter.h"
 
 #define HookImport(module_name, library_nid, func_nid, func_name) taiHookFunctionImportForKernel(KERNEL_PID, &func_name ## _ref, module_name, library_nid, func_nid, func_name ## _patch)
 
@@ -57,7 +65,15 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #define NLM_BIT_DELAY_NET_THREAD	(1 << 1)
 #define NLM_BIT_CONFIG_LOADED		(1 << 2)
 
-#define RINGBUF_LEN 0x2000
+#define NET_SEND_RECS 16
+#define NET_SEND_SPANS (NET_SEND_RECS * 6)
+#define NET_FMT_BUF_LEN 0x1000
+#define NET_RETRY_DELAY (1000 * 1000)
+#define NET_BACKOFF_MIN (250 * 1000)
+#define NET_BACKOFF_MAX (16 * 1000 * 1000)
+#define NET_CONNECT_TIMEOUT (5 * 1000 * 1000)
+#define NET_CONNECT_POLL (20 * 1000)	// how long the ring drains between looks at a pending connect
+#define NET_DGRAM_MAX 1472	// an Ethernet MTU less the IP and UDP headers
 
 static uint32_t NetLoggingMgrFlags = 0;
 
@@ -71,7 +87,7 @@ int (* sceKernelGetModuleInfoForKernel)(SceUID pid, SceUID modid, SceKernelModul
 
 int (* SceDebugForDriver_391B5B74)(const char *fmt, ...);
 int (* sceDebugRegisterPutcharHandlerForKernel)(int (*func)(void *args, char c), void *args);
-int (* sceDebugSetHandlersForKernel)(int (*func)(int unk, const char *format, const va_list args), void *args);
+int (* sceDebugSetHandlersForKernel)(int (*func)(int unk, const char *format, va_list args), void *args);
 void *(* sceDebugGetPutcharHandlerForKernel)(void);
 int (* sceDebugDisableInfoDumpForKernel)(int flags);
 
@@ -113,19 +129,135 @@ unsigned int My_ksceNetInetPton(unsigned char ip1, unsigned char ip2, unsigned c
 	return ip;
 }
 
+NetLoggingMgrConfig_t NetLoggingMgrConfig;
+
+static ringbuf *log_ring;
+static ringbuf *dest_ring[NLM_DEST_MAX - 1];	// of the other destinations, set once they are up to take records
+static SceUID dest_thread_uid[NLM_DEST_MAX - 1];	// and their net_threads, set before they start
+
+// any net_thread, they must not wait for ring space they may be the ones to free
+static int on_net_thread(void){
+
+	SceUID tid = ksceKernelGetThreadId();
+
+	if(tid == net_thread_uid){
+		return 1;
+	}
+	for(int i = 0; i < NLM_DEST_MAX - 1; i++){
+		if(tid == __atomic_load_n(&dest_thread_uid[i], __ATOMIC_RELAXED)){
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// a record from thread tid of process pid, logged at time
+static int log_put_as(int source, int type, char *c, int size, SceUID pid, SceUID tid, SceUInt64 time){
+
+	SceUInt timeout;
+	logrec_hdr hdr;
+	ringbuf_span rec[2];
+
+	hdr.type     = type;
+	hdr.source   = source;
+	hdr.level    = source == NLM_SOURCE_KERNEL_PRINTF ? NLM_LEVEL_DEBUG : NLM_LEVEL_INFO;
+	hdr.reserved = 0;
+	hdr.pid      = pid;
+	hdr.tid      = tid;
+
+	rec[0].ptr = (char *)&hdr;
+	rec[0].len = sizeof(hdr);
+	rec[1].ptr = c;
+	rec[1].len = size;
+
+	// kept for NetLoggingMgrDumpRecent() even once the ring sent or lost it
+	if(type == LOGREC_TYPE_FMT){
+		// which may be after the caller's module and its format are gone
+		const char *fmt;
+		logrec_hdr fr_hdr = hdr;
+		ringbuf_span fr[4];
+
+		memcpy(&fmt, c, sizeof(fmt));
+		fr_hdr.type = LOGREC_TYPE_FMT_COPY;
+		fr[0].ptr = (char *)&fr_hdr;
+		fr[0].len = sizeof(fr_hdr);
+		fr[1].ptr = fmt;
+		fr[1].len = strnlen(fmt, LOGREC_FMT_MAX);
+		fr[2].ptr = "";
+		fr[2].len = 1;
+		fr[3].ptr = c + sizeof(fmt);
+		fr[3].len = size - sizeof(fmt);
+		flightrec_put(fr, 4);
+	}else{
+		flightrec_put(rec, 2);
+	}
+
+	// the other destinations lose their oldest records rather than hold up anyone
+	for(int i = 0; i < NLM_DEST_MAX - 1; i++){
+		ringbuf *rb = __atomic_load_n(&dest_ring[i], __ATOMIC_ACQUIRE);
+
+		if(rb != NULL && NetLoggingMgrConfig.dest[i].IPv4 != 0){
+			ringbuf_putv_clobber_at(rb, rec, 2, time);
+		}
+	}
+
+	switch(NetLoggingMgrConfig.policy[source]){
+	case NLM_POLICY_DROP_NEWEST:
+		return ringbuf_putv_at(log_ring, rec, 2, time);
+	case NLM_POLICY_BLOCK:
+		// net_threads log too, and could end up waiting for themselves
+		if(on_net_thread()){
+			return ringbuf_putv_at(log_ring, rec, 2, time);
+		}
+		timeout = NetLoggingMgrConfig.block_timeout ? NetLoggingMgrConfig.block_timeout : DEFAULT_BLOCK_TIMEOUT;
+		return ringbuf_putv_wait_at(log_ring, rec, 2, time, timeout);
+	default:
+		return ringbuf_putv_clobber_at(log_ring, rec, 2, time);
+	}
+}
+
+static int log_put(int source, int type, char *c, int size){
+	return log_put_as(source, type, c, size, ksceKernelGetProcessId(), ksceKernelGetThreadId(), os_time_us());
+}
+
+// lines from linebuf, which may be put by net_thread once they are stale
+static int log_put_user(char *c, int size, SceUID pid, SceUID tid, SceUInt64 time){
+	return log_put_as(NLM_SOURCE_USER_PUTCHAR, LOGREC_TYPE_TEXT, c, size, pid, tid, time);
+}
+
 // userland printf
 int UserDebugPrintfCallback(void *args, char c){
-	ringbuf_put_clobber(&c, 1);
+	if(filter_drop(ksceKernelGetProcessId(), NULL)){
+		return 0;
+	}
+	linebuf_putchar(c);
 	return 0;
 }
 
-int KernelDebugPrintfCallback(int unk, const char *fmt, const va_list args){
-	char buf[0x400];
+int KernelDebugPrintfCallback(int unk, const char *fmt, va_list args){
+	char buf[LOGREC_MAX_LEN];
 	int buf_len = sizeof(buf);
-	int len = vsnprintf(buf, buf_len, fmt, args);
+	int len;
+
+	// before anything is copied or formatted
+	if(filter_drop(ksceKernelGetProcessId(), fmt)){
+		return 0;
+	}
+
+	// only copy the arguments here, net_thread formats them
+	if(NetLoggingMgrConfig.flags & NLM_CONFIG_FLAGS_BIT_DEFERRED_FORMAT){
+		len = logrec_capture(buf, buf_len, fmt, args);
+		if(len >= 0){
+			log_put(NLM_SOURCE_KERNEL_PRINTF, LOGREC_TYPE_FMT, buf, len);
+			return 0;
+		}
+		// floats, long strings and the like are formatted right away
+	}
+
+	len = vsnprintf(buf, buf_len, fmt, args);
 	len = len < 0 ? 0 : len;
 	len = len >= buf_len ? buf_len - 1 : len;
-	ringbuf_put_clobber(buf, len);
+	log_put(NLM_SOURCE_KERNEL_PRINTF, LOGREC_TYPE_TEXT, buf, len);
 	return 0;
 }
 
@@ -168,27 +300,219 @@ end:
 
 int ksceNetShutdown(int s, int how);
 
-static int net_connect(void) {
-	int net_sock;
+/*
+ * What goes out for the records at the head of the ring. As text, TEXT
+ * records are taken straight from the ring without their logrec_hdr and
+ * FMT records are formatted into fmt_buf. As binary, each record becomes
+ * a frame header from wire_hdr followed by the payload. The header only
+ * has what changed since the frame before, wire_meta is where the last
+ * committed record left the receiver. FMT ones carry the fmtdict ID in
+ * place of the format pointer, and the first one with a new ID also gets
+ * a DICT frame with the string.
+ *
+ * Only whole records are committed. head_skip is how much of the first
+ * record went out already, so a record has to encode the same way every
+ * time until it is committed. A new connection starts over at a record.
+ *
+ * Over TCP a batch stops at batch_size bytes, or after its first
+ * record if that is longer, and net_send_spans gathers it into sends of
+ * that size. Compressed batches are bounded by NET_LZ_BLOCK_MAX instead.
+ *
+ * Over UDP records are grouped into datagrams of up to NET_DGRAM_MAX, each
+ * starting with the hello in binary mode. A datagram decodes on its own,
+ * so its first record is encoded from a zeroed wire_meta with seq and pos
+ * spelled out, and formats always go inline.
+ */
+#define NET_WIRE_TEXT 0
+#define NET_WIRE_BINARY 1
+
+#define NET_WIRE_HDR_LEN (NLM_WIRE_HDR_MAX + sizeof(uint16_t))
+#define NET_REC_SPANS 5		// DICT header, format, FMT_ID header and the arguments in two pieces
+
+typedef struct net_batch {
+	ringbuf_rec rec[NET_SEND_RECS];
+	unsigned int wire_len[NET_SEND_RECS];
+	int n_rec;
+	ringbuf_span span[NET_SEND_SPANS];
+	int n_span;
+	char wire_hdr[NET_SEND_RECS][NET_WIRE_HDR_LEN * 2];	// frame headers, with the ID for DICT and FMT_ID
+	int dict_id[NET_SEND_RECS];		// ID whose DICT frame goes with the record, or -1
+	int dgram[NET_SEND_RECS];		// the record starts a datagram
+	int dgram_span[NET_SEND_RECS];		// and its first span
+	NetLoggingMgrWireMeta_t wire_meta[NET_SEND_RECS];	// where the receiver is after the record
+	char rec_buf[LOGREC_MAX_LEN];		// a FMT payload split by the wrap
+	char fmt_buf[NET_FMT_BUF_LEN];
+} net_batch;
+
+/*
+ * With compression on, the leading records of a batch, up to
+ * NET_LZ_BLOCK_MAX of their frames, go out as one LZ frame. They are only
+ * consumed once all of it went out, and until then the batch encodes the
+ * same, so a block that went out in part is finished before anything
+ * else. A block that does not get smaller goes out as the frames.
+ */
+#define NET_LZ_BLOCK_MAX 0x2000
+#define NET_LZ_HDR_LEN (NLM_WIRE_HDR_MAX + 3)	// and the varint length of the frames
+
+/*
+ * Everything about one destination. Each has a ring of its own that
+ * log_put() writes every record to, so each reads it at its own pace,
+ * and a net_thread of its own. The first is the configured server and
+ * has the spill file. The ones from NetLoggingMgrConfig.dest always
+ * overwrite their oldest records when full, so a slow one loses records
+ * of its own instead of holding up the log or the other destinations.
+ */
+typedef struct net_conn {
+	int index;		// 0 for the server, else 1 + its NetLoggingMgrConfig.dest slot
+	SceUID mem_uid;		// the block it lives in, but for the server
+	ringbuf *ring;
+	SceUID thread_uid;
+	SceUInt64 head_time;	// when the oldest record not sent yet was put, 0 if there is none
+	int up;
+
+	int udp;
+	SceNetSockaddrIn dest;	// the server as it was when the connection started
+
+	net_batch batch;
+	unsigned int head_skip;
+	int wire;		// NET_WIRE_*
+	NetLoggingMgrWireMeta_t wire_meta;
+	int wire_seq_due;	// the next timed header carries seq and pos
+	NetLoggingMgrWireHello_t wire_hello;
+	fmtdict dict;
+	unsigned int batch_size;
+	char send_buf[MAX_BATCH_SIZE];
+	char dgram_buf[NET_DGRAM_MAX];
+
+	int lz;
+	lz_state lz_work;
+	char lz_in[NET_LZ_BLOCK_MAX];
+	char lz_out[NET_LZ_HDR_LEN + LZ_BOUND(NET_LZ_BLOCK_MAX)];
+	unsigned int lz_start, lz_len, lz_sent;	// the LZ frame in lz_out
+	unsigned int lz_raw;	// bytes of the batch it stands for
+
+	unsigned int backoff_n;
+	uint32_t jitter_state;
+
+	// for NetLoggingMgrGetStats()
+	uint32_t connects, connect_failures, disconnects;
+	uint32_t connect_time_last, connect_time_max;
+	uint64_t connect_time_total;
+	uint32_t lz_blocks, lz_fallbacks;
+	uint64_t lz_in_bytes, lz_out_bytes, lz_time;
+	uint32_t sends, batches;
+	uint64_t send_bytes, batch_recs;
+} net_conn;
+
+static net_conn net_server;
+static net_conn *net_conns[NLM_DEST_MAX] = { &net_server };	// the others once they are configured
+
+// where the destination is to be now, 0 if its slot is not in use
+static int net_target(const net_conn *c, SceNetSockaddrIn *addr) {
+	const NetLoggingMgrDest_t *d;
+
+	*addr = server;
+	if (c->index == 0) {
+		return 1;
+	}
+
+	d = &NetLoggingMgrConfig.dest[c->index - 1];
+	addr->sin_addr.s_addr = d->IPv4;
+	addr->sin_port = ksceNetHtons(d->port ? d->port : DEFAULT_PORT);
+	return d->IPv4 != 0;
+}
+
+// datagrams need no connection, and may go to a broadcast or multicast address
+static int net_connect_udp(void) {
+	int net_sock, on = 1;
+
+	net_sock = ksceNetSocket("NetLoggingUDP", SCE_NET_AF_INET, SCE_NET_SOCK_DGRAM, 0);
+	if (net_sock < 0) {
+		return net_sock;
+	}
+	ksceNetSetsockopt(net_sock, SCE_NET_SOL_SOCKET, SCE_NET_SO_BROADCAST, &on, sizeof(on));
+
+	return net_sock;
+}
+
+/*
+ * Start a single attempt without waiting for it, net_connect_poll() tells
+ * when it is done and net_thread decides when to retry.
+ */
+static int net_connect(net_conn *c) {
+	int net_sock, ret, on = 1;
+
+	net_target(c, &c->dest);
+	c->udp = (NetLoggingMgrConfig.flags & NLM_CONFIG_FLAGS_BIT_UDP) != 0;
+	if (c->udp) {
+		return net_connect_udp();
+	}
 
-socket:
 	net_sock = ksceNetSocket("NetLoggingTCP", SCE_NET_AF_INET, SCE_NET_SOCK_STREAM, 0);
 	if (net_sock < 0) {
-		goto socket_error;
+		return net_sock;
 	}
 
 	int timeout = 5 * 1000 * 1000;
 	ksceNetSetsockopt(net_sock, SCE_NET_SOL_SOCKET, SCE_NET_SO_SNDTIMEO, &timeout, sizeof(timeout));
+	// the connection stays up between bursts, this notices a server that went away meanwhile
+	ksceNetSetsockopt(net_sock, SCE_NET_SOL_SOCKET, SCE_NET_SO_KEEPALIVE, &on, sizeof(on));
+	ksceNetSetsockopt(net_sock, SCE_NET_SOL_SOCKET, SCE_NET_SO_NBIO, &on, sizeof(on));
+	if (NetLoggingMgrConfig.flags & NLM_CONFIG_FLAGS_BIT_TCP_NODELAY) {
+		ksceNetSetsockopt(net_sock, SCE_NET_IPPROTO_TCP, SCE_NET_TCP_NODELAY, &on, sizeof(on));
+	}
 
-	if (ksceNetConnect(net_sock, (SceNetSockaddr*)&server, sizeof(server)) == 0) {
+	ret = ksceNetConnect(net_sock, (SceNetSockaddr*)&c->dest, sizeof(c->dest));
+	if (ret == 0 || ret == (int)SCE_NET_ERROR_EINPROGRESS) {
 		return net_sock;
 	}
 	ksceNetShutdown(net_sock, SCE_NET_SHUT_RDWR);
-
-socket_error:
 	ksceNetClose(net_sock);
-	ksceKernelDelayThread(1000 * 1000);
-	goto socket;
+
+	return ret < 0 ? ret : -1;
+}
+
+// 1 once connected, 0 while it is still going and < 0 if it failed
+static int net_connect_poll(net_conn *c, int net_sock) {
+	int ret, off = 0;
+
+	if (c->udp) {
+		return 1;
+	}
+
+	ret = ksceNetConnect(net_sock, (SceNetSockaddr*)&c->dest, sizeof(c->dest));
+	if (ret == (int)SCE_NET_ERROR_EINPROGRESS || ret == (int)SCE_NET_ERROR_EALREADY) {
+		return 0;
+	}
+	if (ret != 0 && ret != (int)SCE_NET_ERROR_EISCONN) {
+		return ret < 0 ? ret : -1;
+	}
+
+	// sends block again, up to SO_SNDTIMEO
+	ksceNetSetsockopt(net_sock, SCE_NET_SOL_SOCKET, SCE_NET_SO_NBIO, &off, sizeof(off));
+	return 1;
+}
+
+// the server closed an idle connection, or it broke
+static int net_peer_closed(net_conn *c, int net_sock) {
+	char ch;
+	int ret;
+
+	if (c->udp) {
+		return 0;
+	}
+
+	ret = ksceNetRecvfrom(net_sock, &ch, sizeof(ch), SCE_NET_MSG_DONTWAIT, NULL, NULL);
+	return ret == 0 || (ret < 0 && ret != (int)SCE_NET_ERROR_EAGAIN);
+}
+
+// the config asks for another server or transport than the connection has
+static int net_config_changed(net_conn *c) {
+	SceNetSockaddrIn addr;
+
+	return !net_target(c, &addr)
+		|| memcmp(&c->dest, &addr, sizeof(addr)) != 0
+		|| c->udp != ((NetLoggingMgrConfig.flags & NLM_CONFIG_FLAGS_BIT_UDP) != 0);
 }
 
 static void net_close(int net_sock) {
@@ -196,7 +520,764 @@ static void net_close(int net_sock) {
 	ksceNetClose(net_sock);
 }
 
+
+// spans for len bytes of the record starting at off
+static int net_rec_sub(const ringbuf_rec *rec, unsigned int off, unsigned int len, ringbuf_span *out) {
+	int n = 0;
+
+	for (int i = 0; i < rec->n_span && len > 0; i++) {
+		unsigned int take;
+
+		if (off >= rec->span[i].len) {
+			off -= rec->span[i].len;
+			continue;
+		}
+		take = rec->span[i].len - off;
+		if (take > len) {
+			take = len;
+		}
+		out[n].ptr = rec->span[i].ptr + off;
+		out[n].len = take;
+		n++;
+		off = 0;
+		len -= take;
+	}
+
+	return n;
+}
+
+static void net_rec_copy(const ringbuf_rec *rec, unsigned int off, void *dst, unsigned int len) {
+	ringbuf_span sub[2];
+	int n = net_rec_sub(rec, off, len, sub);
+
+	for (int i = 0; i < n; i++) {
+		memcpy(dst, sub[i].ptr, sub[i].len);
+		dst = (char *)dst + sub[i].len;
+	}
+}
+
+// the payload of a FMT record in one piece, copied into buf if the wrap splits it
+static const char *net_rec_payload(const ringbuf_rec *rec, char *buf, unsigned int *len) {
+	ringbuf_span sub[2];
+
+	*len = rec->len - sizeof(logrec_hdr);
+	if (net_rec_sub(rec, sizeof(logrec_hdr), *len, sub) == 1) {
+		return sub[0].ptr;
+	}
+	if (*len > LOGREC_MAX_LEN) {
+		*len = 0;
+	}
+	net_rec_copy(rec, sizeof(logrec_hdr), buf, *len);
+	return buf;
+}
+
+static unsigned int net_varint(char *out, uint64_t v) {
+	unsigned int n = 0;
+
+	while (v >= 0x80) {
+		out[n++] = (v & 0x7F) | 0x80;
+		v >>= 7;
+	}
+	out[n++] = v;
+	return n;
+}
+
+/*
+ * A frame header into out, followed by the format ID if id >= 0; returns
+ * its length. last is where the receiver is and moves on to meta, a NULL
+ * meta leaves it there.
+ */
+static unsigned int net_wire_hdr(net_conn *c, char *out, NetLoggingMgrWireMeta_t *last, const NetLoggingMgrWireMeta_t *meta, int type, int level, int id, unsigned int len) {
+	uint16_t wire_id = id;
+	int64_t delta;
+	unsigned int n = 2;
+
+	out[0] = type;
+	out[1] = level & NLM_WIRE_META_LEVEL;
+	n += net_varint(out + n, len + (id >= 0 ? sizeof(wire_id) : 0));
+
+	if (meta == NULL) {
+		out[1] |= NLM_WIRE_META_NO_TIME;
+	} else {
+		// records of different CPUs are close to each other but not in order
+		delta = meta->time - last->time;
+		n += net_varint(out + n, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+		if (meta->source != last->source) {
+			out[1] |= NLM_WIRE_META_SOURCE;
+			out[n++] = meta->source;
+		}
+		if (meta->pid != last->pid) {
+			out[1] |= NLM_WIRE_META_PID;
+			n += net_varint(out + n, meta->pid);
+		}
+		if (meta->tid != last->tid) {
+			out[1] |= NLM_WIRE_META_TID;
+			n += net_varint(out + n, meta->tid);
+		}
+		if (c->wire_seq_due || meta->seq != last->seq || meta->pos != last->pos) {
+			out[1] |= NLM_WIRE_META_SEQ;
+			n += net_varint(out + n, meta->seq);
+			n += net_varint(out + n, meta->pos);
+			c->wire_seq_due = 0;
+		}
+		*last = *meta;
+		if (type == NLM_WIRE_TYPE_TEXT || type == NLM_WIRE_TYPE_FMT || type == NLM_WIRE_TYPE_FMT_ID) {
+			last->seq++;
+			last->pos += len + (id >= 0 ? sizeof(wire_id) : 0);
+		}
+	}
+
+	if (id >= 0) {
+		memcpy(out + n, &wire_id, sizeof(wire_id));
+		n += sizeof(wire_id);
+	}
+	return n;
+}
+
+// whether an earlier record of the batch already takes the DICT frame for id along
+static int net_dict_pending(const net_batch *b, int i, int id) {
+	for (int j = 0; j < i; j++) {
+		if (b->dict_id[j] == id) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * A FMT record as DICT and FMT_ID frames, returns the number of spans or
+ * 0 if it has to be formatted instead.
+ */
+static int net_encode_fmt(net_conn *c, int i, const NetLoggingMgrWireMeta_t *meta, const char *payload, unsigned int len, ringbuf_span *wire) {
+	net_batch *b = &c->batch;
+	const ringbuf_rec *rec = &b->rec[i];
+	NetLoggingMgrWireMeta_t *last = &b->wire_meta[i];
+	char *wire_hdr = b->wire_hdr[i];
+	const char *fmt;
+	unsigned int fmt_size, args_len;
+	int id, n = 0;
+
+	if (len < sizeof(fmt)) {
+		return 0;
+	}
+	memcpy(&fmt, payload, sizeof(fmt));
+	args_len = len - sizeof(fmt);
+
+	fmt_size = strnlen(fmt, NLM_WIRE_FRAME_MAX) + 1;
+	if (NET_WIRE_HDR_LEN + fmt_size > NLM_WIRE_FRAME_MAX || NET_WIRE_HDR_LEN + args_len > NLM_WIRE_FRAME_MAX) {
+		return 0;
+	}
+
+	id = c->udp ? -1 : fmtdict_lookup(&c->dict, fmt);
+	if (id < 0) {
+		// no ID to spare or no DICT frame to count on, the format goes inline
+		if (NET_WIRE_HDR_LEN + fmt_size + args_len > (c->udp ? NET_DGRAM_MAX - sizeof(c->wire_hello) : NLM_WIRE_FRAME_MAX)) {
+			return 0;
+		}
+		wire[n].ptr = wire_hdr;
+		wire[n++].len = net_wire_hdr(c, wire_hdr, last, meta, NLM_WIRE_TYPE_FMT, meta->level, -1, fmt_size + args_len);
+		wire[n].ptr = fmt;
+		wire[n++].len = fmt_size;
+		return n + net_rec_sub(rec, sizeof(logrec_hdr) + sizeof(fmt), args_len, &wire[n]);
+	}
+
+	if (!fmtdict_sent(&c->dict, id) && !net_dict_pending(b, i, id)) {
+		wire[n].ptr = wire_hdr;
+		wire[n++].len = net_wire_hdr(c, wire_hdr, last, meta, NLM_WIRE_TYPE_DICT, meta->level, id, fmt_size);
+		wire[n].ptr = fmt;
+		wire[n++].len = fmt_size;
+		wire_hdr += NET_WIRE_HDR_LEN;
+		b->dict_id[i] = id;
+	}
+
+	wire[n].ptr = wire_hdr;
+	wire[n++].len = net_wire_hdr(c, wire_hdr, last, meta, NLM_WIRE_TYPE_FMT_ID, meta->level, id, args_len);
+	return n + net_rec_sub(rec, sizeof(logrec_hdr) + sizeof(fmt), args_len, &wire[n]);
+}
+
+/*
+ * The wire form of one record into wire, returns the number of spans or
+ * -1 if fmt_buf has no room left for it.
+ */
+static int net_encode_rec(net_conn *c, int i, unsigned int *fmt_len, ringbuf_span *wire) {
+	net_batch *b = &c->batch;
+	const ringbuf_rec *rec = &b->rec[i];
+	NetLoggingMgrWireMeta_t *last = &b->wire_meta[i];
+	NetLoggingMgrWireMeta_t meta;
+	char *wire_hdr = b->wire_hdr[i];
+	const char *payload;
+	unsigned int len, text_len;
+	logrec_hdr hdr;
+	int n = 0;
+
+	b->dict_id[i] = -1;
+
+	memset(&meta, 0, sizeof(meta));
+	meta.time = rec->time;
+	meta.seq  = last->seq;
+	meta.pos  = last->pos;
+
+	if (rec->marker || rec->len < sizeof(hdr)) {
+		meta.source = NLM_WIRE_SOURCE_SELF;
+		meta.level  = NLM_LEVEL_WARN;
+		// the receiver tells about the gap itself
+		if (c->wire == NET_WIRE_BINARY && rec->marker) {
+			meta.seq += rec->lost;
+			meta.pos += rec->lost_bytes;
+			wire[n].ptr = wire_hdr;
+			wire[n++].len = net_wire_hdr(c, wire_hdr, last, &meta, NLM_WIRE_TYPE_LOST, meta.level, -1, 0);
+			return n;
+		}
+		if (c->wire == NET_WIRE_BINARY) {
+			wire[n].ptr = wire_hdr;
+			wire[n++].len = net_wire_hdr(c, wire_hdr, last, &meta, NLM_WIRE_TYPE_TEXT, meta.level, -1, rec->len);
+		}
+		return n + net_rec_sub(rec, 0, rec->len, &wire[n]);
+	}
+
+	net_rec_copy(rec, 0, &hdr, sizeof(hdr));
+	len = rec->len - sizeof(hdr);
+
+	meta.source = hdr.source;
+	meta.level  = hdr.level;
+	meta.pid    = hdr.pid;
+	meta.tid    = hdr.tid;
+
+	if (hdr.type == LOGREC_TYPE_FMT) {
+		payload = net_rec_payload(rec, b->rec_buf, &len);
+
+		// the receiver formats it
+		if (c->wire == NET_WIRE_BINARY) {
+			n = net_encode_fmt(c, i, &meta, payload, len, wire);
+			if (n > 0) {
+				return n;
+			}
+		}
+
+		if (NET_FMT_BUF_LEN - *fmt_len < LOGREC_MAX_LEN) {
+			return -1;
+		}
+		text_len = logrec_format(b->fmt_buf + *fmt_len, LOGREC_MAX_LEN, payload, len);
+		if (c->wire == NET_WIRE_BINARY) {
+			wire[n].ptr = wire_hdr;
+			wire[n++].len = net_wire_hdr(c, wire_hdr, last, &meta, NLM_WIRE_TYPE_TEXT, meta.level, -1, text_len);
+		}
+		wire[n].ptr = b->fmt_buf + *fmt_len;
+		wire[n++].len = text_len;
+		*fmt_len += text_len;
+		return n;
+	}
+
+	if (c->wire == NET_WIRE_BINARY) {
+		wire[n].ptr = wire_hdr;
+		wire[n++].len = net_wire_hdr(c, wire_hdr, last, &meta, NLM_WIRE_TYPE_TEXT, meta.level, -1, len);
+	}
+	return n + net_rec_sub(rec, sizeof(hdr), len, &wire[n]);
+}
+
+// record i with the receiver where the one before left it, or from scratch at a datagram
+static int net_encode_at(net_conn *c, int i, unsigned int *fmt_len, ringbuf_span *wire, int dgram) {
+	net_batch *b = &c->batch;
+	int n_wire;
+
+	b->wire_meta[i] = i > 0 ? b->wire_meta[i - 1] : c->wire_meta;
+	b->dgram[i] = dgram;
+	if (dgram && c->wire == NET_WIRE_BINARY) {
+		uint32_t seq = b->wire_meta[i].seq;
+		uint64_t pos = b->wire_meta[i].pos;
+
+		memset(&b->wire_meta[i], 0, sizeof(b->wire_meta[i]));
+		b->wire_meta[i].seq = seq;
+		b->wire_meta[i].pos = pos;
+		c->wire_seq_due = 1;
+
+		wire[0].ptr = (const char *)&c->wire_hello;
+		wire[0].len = sizeof(c->wire_hello);
+		n_wire = net_encode_rec(c, i, fmt_len, wire + 1);
+		return n_wire < 0 ? n_wire : n_wire + 1;
+	}
+
+	return net_encode_rec(c, i, fmt_len, wire);
+}
+
+// peek at the head of the ring and build the spans to send, returns the number of records
+static int net_encode(net_conn *c) {
+	net_batch *b = &c->batch;
+	int n_rec = ringbuf_peek_recs(c->ring, b->rec, NET_SEND_RECS);
+	unsigned int fmt_len = 0, dgram_len = 0, batch_len = 0;
+	unsigned int skip = c->head_skip;
+
+	b->n_rec = 0;
+	b->n_span = 0;
+
+	for (int i = 0; i < n_rec; i++) {
+		ringbuf_span wire[NET_REC_SPANS + 1];
+		unsigned int fmt_mark = fmt_len, len = 0;
+		int n_wire;
+
+		if (b->n_span + NET_REC_SPANS + 1 > NET_SEND_SPANS) {
+			break;
+		}
+		n_wire = net_encode_at(c, i, &fmt_len, wire, c->udp && i == 0);
+		if (n_wire < 0) {
+			break;
+		}
+		for (int j = 0; j < n_wire; j++) {
+			len += wire[j].len;
+		}
+
+		// too much for this datagram, it starts the next one
+		if (c->udp && !b->dgram[i] && dgram_len + len > NET_DGRAM_MAX) {
+			fmt_len = fmt_mark;
+			n_wire = net_encode_at(c, i, &fmt_len, wire, 1);
+			len = 0;
+			for (int j = 0; j < n_wire; j++) {
+				len += wire[j].len;
+			}
+		}
+		if (b->dgram[i]) {
+			b->dgram_span[i] = b->n_span;
+			dgram_len = 0;
+		}
+		dgram_len += len;
+
+		if (!c->udp && !c->lz && i > 0 && batch_len + len > c->batch_size) {
+			break;
+		}
+		batch_len += len;
+
+		b->wire_len[i] = len;
+		for (int j = 0; j < n_wire; j++) {
+			// the part of the first record that was sent before
+			if (skip >= wire[j].len) {
+				skip -= wire[j].len;
+				continue;
+			}
+			b->span[b->n_span].ptr = wire[j].ptr + skip;
+			b->span[b->n_span].len = wire[j].len - skip;
+			b->n_span++;
+			skip = 0;
+		}
+		b->n_rec++;
+	}
+
+	c->head_time = b->n_rec > 0 ? b->rec[0].time : 0;
+	return b->n_rec;
+}
+
+// sent bytes of the batch went out, whole records go back to the ring; returns how many
+static int net_consume(net_conn *c, unsigned int sent) {
+	net_batch *b = &c->batch;
+	unsigned int done = 0;
+	int i;
+
+	sent += c->head_skip;
+	for (i = 0; i < b->n_rec && sent >= b->wire_len[i]; i++) {
+		sent -= b->wire_len[i];
+		done += b->rec[i].len;
+		// the receiver has the string now
+		if (b->dict_id[i] >= 0) {
+			fmtdict_set_sent(&c->dict, b->dict_id[i]);
+		}
+		c->wire_meta = b->wire_meta[i];
+	}
+	c->head_skip = i < b->n_rec ? sent : 0;
+
+	if (done > 0) {
+		ringbuf_commit(c->ring, done);
+	}
+	return i;
+}
+
+/*
+ * Send the spans in order, gathered into sends of up to batch_size
+ * so that a batch of small records does not become as many packets.
+ * Returns the number of bytes that went out.
+ */
+static int net_send_spans(net_conn *c, int net_sock, const ringbuf_span *span, int n_span) {
+	unsigned int off = 0;
+	int sent = 0, i = 0;
+
+	while (i < n_span) {
+		unsigned int len = 0;
+		int ret;
+
+		for (; i < n_span && len < c->batch_size; off = 0, i++) {
+			unsigned int n = span[i].len - off;
+
+			if (n > c->batch_size - len) {
+				n = c->batch_size - len;
+			}
+			memcpy(c->send_buf + len, span[i].ptr + off, n);
+			len += n;
+			off += n;
+			if (off < span[i].len) {
+				break;
+			}
+		}
+		if (len == 0) {
+			break;
+		}
+
+		ret = ksceNetSend(net_sock, c->send_buf, len, 0);
+		if (ret < 0) {
+			return sent ? sent : ret;
+		}
+		c->sends++;
+		c->send_bytes += ret;
+		sent += ret;
+		if ((unsigned int)ret < len) {
+			break;
+		}
+	}
+
+	return sent;
+}
+
+// one datagram from the spans, the whole of it or nothing
+static int net_send_dgram(net_conn *c, int net_sock, const ringbuf_span *span, int n_span) {
+	unsigned int len = 0;
+	int ret;
+
+	for (int i = 0; i < n_span; i++) {
+		// net_encode keeps datagrams within NET_DGRAM_MAX
+		if (span[i].len > sizeof(c->dgram_buf) - len) {
+			return -1;
+		}
+		memcpy(c->dgram_buf + len, span[i].ptr, span[i].len);
+		len += span[i].len;
+	}
+
+	ret = ksceNetSendto(net_sock, c->dgram_buf, len, 0, (SceNetSockaddr *)&c->dest, sizeof(c->dest));
+	if (ret < 0) {
+		return ret;
+	}
+	c->sends++;
+	c->send_bytes += ret;
+	return (unsigned int)ret == len ? ret : -1;
+}
+
+// the datagrams of the batch in order, returns the number of bytes that went out
+static int net_send_dgrams(net_conn *c, int net_sock) {
+	net_batch *b = &c->batch;
+	int sent = 0;
+
+	for (int i = 0; i < b->n_rec; i++) {
+		int end = b->n_span, ret;
+
+		if (!b->dgram[i]) {
+			continue;
+		}
+		for (int j = i + 1; j < b->n_rec; j++) {
+			if (b->dgram[j]) {
+				end = b->dgram_span[j];
+				break;
+			}
+		}
+		ret = net_send_dgram(c, net_sock, &b->span[b->dgram_span[i]], end - b->dgram_span[i]);
+		if (ret < 0) {
+			return sent ? sent : ret;
+		}
+		sent += ret;
+	}
+
+	return sent;
+}
+
+// the leading records of the batch as an LZ frame, returns the number of batch bytes that went out
+static int net_send_lz(net_conn *c, int net_sock) {
+	net_batch *b = &c->batch;
+	char hdr[NET_LZ_HDR_LEN];
+	unsigned int raw = 0, n = 0, hdr_len = 0;
+	SceUInt64 start;
+	int i, ret;
+
+	if (c->lz_len == 0) {
+		for (i = 0; i < b->n_rec && raw + b->wire_len[i] <= sizeof(c->lz_in); i++) {
+			raw += b->wire_len[i];
+		}
+		if (raw == 0) {
+			return net_send_spans(c, net_sock, b->span, b->n_span);
+		}
+		// records have spans of their own
+		for (i = 0; n < raw; i++) {
+			memcpy(c->lz_in + n, b->span[i].ptr, b->span[i].len);
+			n += b->span[i].len;
+		}
+
+		start = ksceKernelGetSystemTimeWide();
+		ret = lz_compress(&c->lz_work, c->lz_in, raw, c->lz_out + sizeof(hdr), sizeof(c->lz_out) - sizeof(hdr));
+		c->lz_time += ksceKernelGetSystemTimeWide() - start;
+		c->lz_in_bytes += raw;
+
+		if (ret > 0) {
+			n = net_varint(hdr, raw);
+			hdr_len = net_wire_hdr(c, hdr, &c->wire_meta, NULL, NLM_WIRE_TYPE_LZ, NLM_LEVEL_INFO, -1, n + ret);
+			hdr_len += net_varint(hdr + hdr_len, raw);
+		}
+		if (ret <= 0 || hdr_len + ret >= raw) {
+			c->lz_fallbacks++;
+			c->lz_out_bytes += raw;
+			return net_send_spans(c, net_sock, b->span, b->n_span);
+		}
+
+		c->lz_start = sizeof(hdr) - hdr_len;
+		memcpy(c->lz_out + c->lz_start, hdr, hdr_len);
+		c->lz_len = hdr_len + ret;
+		c->lz_sent = 0;
+		c->lz_raw = raw;
+		c->lz_blocks++;
+		c->lz_out_bytes += c->lz_len;
+	}
+
+	ret = ksceNetSend(net_sock, c->lz_out + c->lz_start + c->lz_sent, c->lz_len - c->lz_sent, 0);
+	if (ret < 0) {
+		return ret;
+	}
+	c->sends++;
+	c->send_bytes += ret;
+	c->lz_sent += ret;
+	if (c->lz_sent < c->lz_len) {
+		return 0;
+	}
+
+	c->lz_len = 0;
+	return c->lz_raw;
+}
+
+// wait for a batch of log records, putting partial user lines into the ring once they are due
+static int net_peek_wait(net_conn *c, SceUInt *timeout) {
+	SceUInt64 start = ksceKernelGetSystemTimeWide();
+
+	while(1){
+		// the server's thread does it for everyone
+		SceUInt wait = c->index == 0 ? linebuf_flush_stale() : 0;
+
+		if (timeout != NULL) {
+			SceUInt64 elapsed = ksceKernelGetSystemTimeWide() - start;
+			if (elapsed >= *timeout) {
+				// whatever is left, even if it is not a full batch
+				return net_encode(c);
+			}
+			if (wait == 0 || wait > *timeout - elapsed) {
+				wait = *timeout - elapsed;
+			}
+		}
+
+		if (ringbuf_wait(c->ring, wait ? &wait : NULL)) {
+			int n_rec = net_encode(c);
+			if (n_rec > 0) {
+				return n_rec;
+			}
+		}
+		if (!net_thread_run) {
+			return 0;
+		}
+	}
+}
+
+/*
+ * Records stay claimed only while they are being sent. Without a
+ * connection they go back to the ring, so a full ring still evicts the
+ * oldest of them instead of dropping the newest records. One that partly
+ * went to storage goes again in full, as it does on a new connection.
+ */
+static void net_unclaim(net_conn *c) {
+	ringbuf_unpeek(c->ring);
+	c->batch.n_rec = 0;
+	c->batch.n_span = 0;
+	c->head_skip = 0;
+}
+
+/*
+ * There is no connection until deadline. Meanwhile move ring data to
+ * storage when spilling is enabled for the server, or leave it in the ring.
+ */
+static void net_drain(net_conn *c, SceUInt64 deadline) {
+	SceUInt64 now = ksceKernelGetSystemTimeWide();
+	int n_rec;
+
+	while(net_thread_run && now < deadline){
+		if(c->index != 0 || !(NetLoggingMgrConfig.flags & NLM_CONFIG_FLAGS_BIT_SPILL)){
+			ksceKernelDelayThread(deadline - now);
+			break;
+		}
+
+		n_rec = net_peek_wait(c, (SceUInt[]){deadline - now});
+		if (n_rec > 0) {
+			int len = spill_write(c->batch.span, c->batch.n_span);
+			if (len < 0) {
+				// storage failed as well, the data stays in the ring
+				net_unclaim(c);
+				now = ksceKernelGetSystemTimeWide();
+				if (now < deadline) {
+					ksceKernelDelayThread(deadline - now);
+				}
+				break;
+			}
+			net_consume(c, len);
+		}
+		now = ksceKernelGetSystemTimeWide();
+	}
+}
+
+// a destination taken out of the config lets go of what it had
+static void net_discard(net_conn *c) {
+	net_batch *b = &c->batch;
+	int n_rec;
+
+	while ((n_rec = ringbuf_peek_recs(c->ring, b->rec, NET_SEND_RECS)) > 0) {
+		unsigned int len = 0;
+
+		for (int i = 0; i < n_rec; i++) {
+			len += b->rec[i].len;
+		}
+		ringbuf_commit(c->ring, len);
+	}
+	c->head_time = 0;
+}
+
+/*
+ * When to try connecting again: exponential backoff from NET_BACKOFF_MIN
+ * up to NET_BACKOFF_MAX, each wait somewhere in the upper half of its
+ * step so that several consoles do not retry in lockstep.
+ */
+static SceUInt64 net_backoff(net_conn *c) {
+	SceUInt64 step = NET_BACKOFF_MIN;
+	uint32_t x = c->jitter_state;
+
+	for (unsigned int i = 0; i < c->backoff_n && step < NET_BACKOFF_MAX; i++) {
+		step *= 2;
+	}
+	if (step > NET_BACKOFF_MAX) {
+		step = NET_BACKOFF_MAX;
+	}
+	c->backoff_n++;
+
+	// xorshift, seeded from the clock on first use
+	if (x == 0) {
+		x = (uint32_t)ksceKernelGetSystemTimeWide() | 1;
+	}
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	c->jitter_state = x;
+
+	return ksceKernelGetSystemTimeWide() + step / 2 + x % (step / 2);
+}
+
+// a connection starts at a record, encoded the way the config says at that time
+static int net_start(net_conn *c, int net_sock) {
+	NetLoggingMgrWireHello_t hello;
+
+	c->head_skip = 0;
+	c->wire = NET_WIRE_TEXT;
+	// the receiver starts with an empty dictionary and no time
+	fmtdict_reset(&c->dict);
+	memset(&c->wire_meta, 0, sizeof(c->wire_meta));
+	c->wire_seq_due = 0;
+	c->lz = 0;
+	c->lz_len = 0;
+
+	c->batch_size = NetLoggingMgrConfig.batch_size ? NetLoggingMgrConfig.batch_size : DEFAULT_BATCH_SIZE;
+	if (c->batch_size < MIN_BATCH_SIZE) {
+		c->batch_size = MIN_BATCH_SIZE;
+	} else if (c->batch_size > MAX_BATCH_SIZE) {
+		c->batch_size = MAX_BATCH_SIZE;
+	}
+
+	if(!(NetLoggingMgrConfig.flags & NLM_CONFIG_FLAGS_BIT_BINARY_WIRE)){
+		return 0;
+	}
+
+	memcpy(hello.magic, NLM_WIRE_MAGIC, sizeof(hello.magic));
+	hello.version   = NLM_WIRE_VERSION;
+	hello.long_size = sizeof(long);
+	hello.ptr_size  = sizeof(void *);
+
+	// each datagram starts with it instead
+	c->wire_hello = hello;
+	if (!c->udp && ksceNetSend(net_sock, &hello, sizeof(hello), 0) != sizeof(hello)) {
+		return -1;
+	}
+
+	c->wire = NET_WIRE_BINARY;
+	c->lz = !c->udp && (NetLoggingMgrConfig.flags & NLM_CONFIG_FLAGS_BIT_COMPRESS);
+	return 0;
+}
+
+// spilled data is text
+static void net_stop(net_conn *c, int net_sock) {
+	net_close(net_sock);
+	c->head_skip = 0;
+	c->wire = NET_WIRE_TEXT;
+	c->udp = 0;
+	c->lz = 0;
+	c->lz_len = 0;
+}
+
+// spilled data is older than anything in the ring, so it goes first
+static int net_replay(net_conn *c, int net_sock) {
+	char wire_hdr[NLM_WIRE_HDR_MAX];
+	unsigned int hdr_len;
+	const char *ptr;
+	int len, sent;
+
+	// not in the middle of an LZ frame, and only the server has any
+	if (c->lz_len > 0 || c->index != 0) {
+		return 0;
+	}
+
+	while ((len = spill_peek(&ptr)) > 0) {
+		// the rest of the chunk goes in the next datagram
+		if (c->udp && len > (int)(NET_DGRAM_MAX - sizeof(c->wire_hello) - NLM_WIRE_HDR_MAX)) {
+			len = NET_DGRAM_MAX - sizeof(c->wire_hello) - NLM_WIRE_HDR_MAX;
+		}
+
+		if (c->wire == NET_WIRE_BINARY) {
+			// a chunk is a frame of its own and only counts once all of it went out
+			// storage has no times, and the batch is encoded already, so wire_meta stays
+			hdr_len = net_wire_hdr(c, wire_hdr, &c->wire_meta, NULL, NLM_WIRE_TYPE_TEXT, NLM_LEVEL_INFO, -1, len);
+			if (c->udp) {
+				sent = net_send_dgram(c, net_sock, (ringbuf_span[]){{(const char *)&c->wire_hello, sizeof(c->wire_hello)}, {wire_hdr, hdr_len}, {ptr, len}}, 3);
+				sent -= sent > 0 ? sizeof(c->wire_hello) : 0;
+			} else {
+				sent = net_send_spans(c, net_sock, (ringbuf_span[]){{wire_hdr, hdr_len}, {ptr, len}}, 2);
+			}
+			if (sent < 0) {
+				return sent;
+			}
+			if ((unsigned int)sent != hdr_len + len) {
+				return -1;
+			}
+			spill_commit(len);
+			continue;
+		}
+
+		if (c->udp) {
+			sent = net_send_dgram(c, net_sock, (ringbuf_span[]){{ptr, len}}, 1);
+		} else {
+			sent = net_send_spans(c, net_sock, (ringbuf_span[]){{ptr, len}}, 1);
+		}
+		if (sent < 0) {
+			return sent;
+		}
+		spill_commit(sent);
+	}
+
+	return 0;
+}
+
+#define NET_STATE_DOWN 0	// no connection, maybe backing off until retry_at
+#define NET_STATE_CONNECTING 1
+#define NET_STATE_UP 2
+
 static int net_thread(SceSize args, void *argp){
+	net_conn *c = *(net_conn **)argp;
+	int net_sock = -1, state = NET_STATE_DOWN;
+	SceUInt64 retry_at = 0, connect_start = 0, now;
+	SceNetSockaddrIn addr;
+
 	if(NetLoggingMgrFlags & NLM_BIT_DELAY_NET_THREAD){
 		ksceKernelDelayThread(8 * 1000 * 1000);
 	}
@@ -206,30 +1287,138 @@ static int net_thread(SceSize args, void *argp){
 	ksceDebugPrintf("\n");
 
 	while(net_thread_run){
-		char buf[0x400];
-		int received_len = ringbuf_get_wait(buf, sizeof(buf), NULL);
-		if (received_len == 0) {
+		int n_rec, sent, ret, spilled;
+
+		now = ksceKernelGetSystemTimeWide();
+		c->up = state == NET_STATE_UP;
+
+		switch (state) {
+		case NET_STATE_DOWN:
+			net_unclaim(c);
+
+			// the log keeps going to storage instead of waiting for the server
+			if (now < retry_at) {
+				net_drain(c, retry_at);
+				if (c->index == 0) {
+					spill_flush();
+				}
+				continue;
+			}
+
+			// log_put() stops filling the ring, and it may be back later
+			if (!net_target(c, &addr)) {
+				net_discard(c);
+				retry_at = now + NET_RETRY_DELAY;
+				continue;
+			}
+
+			// spilled data wants a connection even while the ring is quiet
+			spilled = c->index == 0 && spill_pending();
+			n_rec = net_peek_wait(c, spilled ? (SceUInt[]){NET_RETRY_DELAY} : NULL);
+			if (n_rec == 0 && !spilled) {
+				continue;
+			}
+			// it was only to know there is something to send
+			net_unclaim(c);
+
+			connect_start = ksceKernelGetSystemTimeWide();
+			net_sock = net_connect(c);
+			if (net_sock < 0) {
+				c->connect_failures++;
+				retry_at = net_backoff(c);
+				continue;
+			}
+			state = NET_STATE_CONNECTING;
 			continue;
-		}
-
-		int net_sock;
 
-	connect:
-		net_sock = net_connect();
+		case NET_STATE_CONNECTING:
+			ret = net_connect_poll(c, net_sock);
+			if (ret == 0 && now - connect_start < NET_CONNECT_TIMEOUT) {
+				net_drain(c, now + NET_CONNECT_POLL);
+				continue;
+			}
+			if (ret <= 0) {
+				net_stop(c, net_sock);
+				net_sock = -1;
+				c->connect_failures++;
+				retry_at = net_backoff(c);
+				state = NET_STATE_DOWN;
+				continue;
+			}
+
+			c->connects++;
+			c->connect_time_last = ksceKernelGetSystemTimeWide() - connect_start;
+			c->connect_time_total += c->connect_time_last;
+			if (c->connect_time_last > c->connect_time_max) {
+				c->connect_time_max = c->connect_time_last;
+			}
+			c->backoff_n = 0;
+			state = NET_STATE_UP;
+
+			if (net_start(c, net_sock) < 0) {
+				goto send_error;
+			}
+			n_rec = net_encode(c);
+			break;
+
+		default:	// NET_STATE_UP
+			// a new server or transport takes a new connection, which is not a failure
+			if (net_config_changed(c)) {
+				net_stop(c, net_sock);
+				net_sock = -1;
+				retry_at = 0;
+				state = NET_STATE_DOWN;
+				continue;
+			}
+
+			// the connection stays between bursts
+			n_rec = net_peek_wait(c, (SceUInt[]){1000 * 1000});
+			if (n_rec == 0) {
+				if (net_peer_closed(c, net_sock)) {
+					goto send_error;
+				}
+				continue;
+			}
+			break;
+		}
 
-	send:
-		if (ksceNetSend(net_sock, buf, received_len, 0) < 0) {
-			net_close(net_sock);
-			ksceKernelDelayThread(1000 * 1000);
-			goto connect;
+		if (net_replay(c, net_sock) < 0) {
+			goto send_error;
 		}
 
-		received_len = ringbuf_get_wait(buf, sizeof(buf), (SceUInt[]){1000 * 1000});
-		if (received_len > 0) {
-			goto send;
+		// data is only consumed once it went out
+		if (n_rec > 0) {
+			if (c->udp) {
+				sent = net_send_dgrams(c, net_sock);
+			} else if (c->lz && (c->lz_len > 0 || c->head_skip == 0)) {
+				sent = net_send_lz(c, net_sock);
+			} else {
+				sent = net_send_spans(c, net_sock, c->batch.span, c->batch.n_span);
+			}
+			if (sent < 0) {
+				goto send_error;
+			}
+			if (sent > 0) {
+				c->batches++;
+				c->batch_recs += net_consume(c, sent);
+			}
 		}
+		continue;
+
+	send_error:
+		net_stop(c, net_sock);
+		net_sock = -1;
+		c->disconnects++;
+		retry_at = net_backoff(c);
+		state = NET_STATE_DOWN;
+	}
 
-		net_close(net_sock);
+	if (net_sock >= 0) {
+		net_stop(c, net_sock);
+	}
+	c->up = 0;
+	if (c->index == 0) {
+		spill_flush();
 	}
 
 	return 0;
@@ -238,7 +1427,6 @@ static int net_thread(SceSize args, void *argp){
 
 
 
-NetLoggingMgrConfig_t NetLoggingMgrConfig;
 SceUID hook_uid[0x20];
 
 /*
@@ -250,42 +1438,275 @@ static int SceQafMgrForDriver_382C71E8_patch(void){
 	//return 1;
 }
 
-int NetLoggingMgrUpdateConfig(NetLoggingMgrConfig_t *new_config){
+static int config_ring_size(void){
+
+	uint32_t size = NetLoggingMgrConfig.ring_size;
+
+	if(size == 0){
+		return DEFAULT_RING_SIZE;
+	}
+
+	if(size < MIN_RING_SIZE){
+		size = MIN_RING_SIZE;
+	}else if(size > MAX_RING_SIZE){
+		size = MAX_RING_SIZE;
+	}
+
+	return size;
+}
+
+// a batch size of its own is a better default watermark than a segment
+static void config_wakeup(ringbuf *rb){
+	ringbuf_set_wakeup(rb,
+		NetLoggingMgrConfig.wake_watermark ? NetLoggingMgrConfig.wake_watermark :
+		NetLoggingMgrConfig.batch_size ? NetLoggingMgrConfig.batch_size : DEFAULT_WAKE_WATERMARK,
+		NetLoggingMgrConfig.wake_latency ? NetLoggingMgrConfig.wake_latency : DEFAULT_WAKE_LATENCY
+	);
+}
+
+static void dest_destroy(net_conn *c){
+
+	if(c->thread_uid > 0){
+		ksceKernelDeleteThread(c->thread_uid);
+	}
+	if(c->ring != NULL){
+		ringbuf_destroy(c->ring);
+	}
+	os_mem_free(c->mem_uid);
+}
+
+static net_conn *dest_create(int index){
+
+	net_conn *c;
+	SceUID mem_uid;
+
+	c = os_mem_alloc("NetLoggingDest", sizeof(*c), &mem_uid);
+	if(c == NULL){
+		return NULL;
+	}
+	memset(c, 0, sizeof(*c));
+	c->index   = index;
+	c->mem_uid = mem_uid;
+
+	c->ring = ringbuf_create(config_ring_size(), RINGBUF_FLAG_MIRRORED);
+	if(c->ring == NULL){
+		goto error;
+	}
+	config_wakeup(c->ring);
+
+	c->thread_uid = ksceKernelCreateThread("net_thread", net_thread, 0x40, 0x1000, 0, 0, 0);
+	if(c->thread_uid < 0){
+		goto error;
+	}
+
+	return c;
+
+error:
+	dest_destroy(c);
+	return NULL;
+}
+
+/*
+ * A destination gets its net_conn the first time its slot is in use and
+ * keeps it until NetLoggingMgrFinish(), a slot that is cleared only
+ * leaves its thread idle.
+ */
+static int config_dests(void){
+
+	for(int i = 1; i < NLM_DEST_MAX; i++){
+		net_conn *c, *expect = NULL;
+
+		if(NetLoggingMgrConfig.dest[i - 1].IPv4 == 0 || __atomic_load_n(&net_conns[i], __ATOMIC_ACQUIRE) != NULL){
+			continue;
+		}
+
+		c = dest_create(i);
+		if(c == NULL){
+			return -1;
+		}
+
+		// another config update got there first
+		if(!__atomic_compare_exchange_n(&net_conns[i], &expect, c, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+			dest_destroy(c);
+			continue;
+		}
+
+		__atomic_store_n(&dest_thread_uid[i - 1], c->thread_uid, __ATOMIC_RELAXED);
+		ksceKernelStartThread(c->thread_uid, sizeof(c), &c);
+		__atomic_store_n(&dest_ring[i - 1], c->ring, __ATOMIC_RELEASE);
+	}
+
+	return 0;
+}
+
+static uint32_t filter_modules = 0;
+
+/*
+ * Module names become the address ranges of their segments here, so a
+ * module loaded later is only muted by the next config update.
+ */
+static void config_filter(void){
+
+	const NetLoggingMgrFilter_t *filter = &NetLoggingMgrConfig.filter;
+	filter_range range[FILTER_RANGE_MAX];
+	int n_range = 0;
+	uint32_t n_module = 0;
+
+	SceKernelModuleInfo info;
+	SceUID modlist[128];
+	size_t count = 0;
+
+	// the module list is only walked if some module is muted
+	for(int i = 0; i < NLM_FILTER_MODULE_MAX; i++){
+		if(filter->module[i][0] != '\0'){
+			count = 128;
+		}
+	}
+
+	if(count != 0 && sceKernelGetModuleListForKernel(KERNEL_PID, 0x7FFFFFFF, 1, modlist, &count) < 0){
+		count = 0;
+	}
+
+	for(size_t i = 0; i < count; i++){
+
+		info.size = sizeof(info);
+		if(sceKernelGetModuleInfoForKernel(KERNEL_PID, modlist[i], &info) < 0){
+			continue;
+		}
+
+		for(int j = 0; j < NLM_FILTER_MODULE_MAX; j++){
+			if(filter->module[j][0] == '\0' || strncmp(info.module_name, filter->module[j], NLM_FILTER_NAME_LEN) != 0){
+				continue;
+			}
+
+			n_module++;
+			for(int k = 0; k < 4 && n_range < FILTER_RANGE_MAX; k++){
+				if(info.segments[k].memsz == 0){
+					continue;
+				}
+				range[n_range].start = (uintptr_t)info.segments[k].vaddr;
+				range[n_range].end   = (uintptr_t)info.segments[k].vaddr + info.segments[k].memsz;
+				n_range++;
+			}
+			break;
+		}
+	}
+
+	filter_update(filter->pid, NLM_FILTER_PID_MAX, range, n_range);
+	filter_modules = n_module;
+}
+
+// fails while a previous resize is still draining, try again later
+static int config_rings(void){
+
+	int res = 0, ret;
+
+	for(int i = 0; i < NLM_DEST_MAX; i++){
+		net_conn *c = __atomic_load_n(&net_conns[i], __ATOMIC_ACQUIRE);
+
+		if(c == NULL || c->ring == NULL){
+			continue;
+		}
+
+		config_wakeup(c->ring);
+		ret = ringbuf_resize(c->ring, config_ring_size());
+		if(ret < 0){
+			res = ret;
+		}
+	}
+
+	return res;
+}
+
+/*
+ * size is how much of NetLoggingMgrConfig_t the caller was built with,
+ * only that much is copied. Fields past it keep their current values.
+ *
+ * The config is checked in full before any of it is used. Once it is,
+ * the filter and the destinations always take effect, a ring size that
+ * cannot be applied yet is only reported.
+ */
+static int config_update(NetLoggingMgrConfig_t *new_config, unsigned int size){
 
 	int res;
-	uint32_t state;
 
 	const char magic[4] = {'N', 'L', 'M', '\0'};
-	char chk_magic[4];
-
-	ENTER_SYSCALL(state);
+	NetLoggingMgrConfig_t config;
 
-	res = ksceKernelMemcpyUserToKernel(&chk_magic, (uintptr_t)new_config, 4);
-	if(res < 0){
-		goto end;
+	if(size < NLM_CONFIG_MIN_SIZE){
+		return SCE_KERNEL_ERROR_INVALID_ARGUMENT_SIZE;
 	}
 
-	if(memcmp(chk_magic, magic, 4) != 0){
-		res = SCE_KERNEL_ERROR_ILLEGAL_TYPE;
-		goto end;
+	if(size > sizeof(config)){
+		size = sizeof(config);
 	}
 
-	res = ksceKernelMemcpyUserToKernel(&NetLoggingMgrConfig, (uintptr_t)new_config, sizeof(NetLoggingMgrConfig_t));
+	memcpy(&config, &NetLoggingMgrConfig, sizeof(config));
+
+	res = ksceKernelMemcpyUserToKernel(&config, (uintptr_t)new_config, size);
 	if(res < 0){
-		goto end;
+		return res;
 	}
 
+	if(memcmp(&config, magic, 4) != 0){
+		return SCE_KERNEL_ERROR_ILLEGAL_TYPE;
+	}
+
+	memcpy(&NetLoggingMgrConfig, &config, sizeof(config));
+
 	server.sin_addr.s_addr = NetLoggingMgrConfig.IPv4;
 	server.sin_port = ksceNetHtons(NetLoggingMgrConfig.port ? NetLoggingMgrConfig.port : DEFAULT_PORT);
-	
+
 	res = 0;
 
-end:
+	if(log_ring != NULL){
+		config_filter();
+		res = config_dests();
+		if(config_rings() < 0 && res == 0){
+			res = NLM_CONFIG_RING_BUSY;
+		}
+	}
+
+	return res;
+}
+
+static int config_read(NetLoggingMgrConfig_t *new_config, unsigned int size){
+
+	if(size > sizeof(NetLoggingMgrConfig_t)){
+		size = sizeof(NetLoggingMgrConfig_t);
+	}
+
+	return ksceKernelMemcpyKernelToUser((uintptr_t)new_config, &NetLoggingMgrConfig, size);
+}
+
+// apps built before the config grew only know its first NLM_CONFIG_MIN_SIZE bytes
+int NetLoggingMgrUpdateConfig(NetLoggingMgrConfig_t *new_config){
+
+	int res;
+	uint32_t state;
+
+	ENTER_SYSCALL(state);
+
+	res = config_update(new_config, NLM_CONFIG_MIN_SIZE);
+
 	EXIT_SYSCALL(state);
 
 	return res;
 }
 
+int NetLoggingMgrUpdateConfigSized(NetLoggingMgrConfig_t *new_config, unsigned int size){
+
+	int res;
+	uint32_t state;
+
+	ENTER_SYSCALL(state);
+
+	res = config_update(new_config, size);
+
+	EXIT_SYSCALL(state);
+
+	return res;
+}
 
 int NetLoggingMgrReadConfig(NetLoggingMgrConfig_t *new_config){
 
@@ -294,7 +1715,109 @@ int NetLoggingMgrReadConfig(NetLoggingMgrConfig_t *new_config){
 
 	ENTER_SYSCALL(state);
 
-	res = ksceKernelMemcpyKernelToUser((uintptr_t)new_config, &NetLoggingMgrConfig, sizeof(NetLoggingMgrConfig_t));
+	res = config_read(new_config, NLM_CONFIG_MIN_SIZE);
+
+	EXIT_SYSCALL(state);
+
+	return res;
+}
+
+int NetLoggingMgrReadConfigSized(NetLoggingMgrConfig_t *new_config, unsigned int size){
+
+	int res;
+	uint32_t state;
+
+	ENTER_SYSCALL(state);
+
+	res = config_read(new_config, size);
+
+	EXIT_SYSCALL(state);
+
+	return res;
+}
+
+static void dest_get_stats(net_conn *c, NetLoggingMgrDestStats_t *stats){
+
+	ringbuf_stats rb_stats;
+	SceUInt64 head_time = c->head_time;
+	SceUInt64 now = ksceKernelGetSystemTimeWide();
+
+	ringbuf_get_stats(c->ring, &rb_stats);
+
+	stats->up            = c->up;
+	stats->pending_bytes = rb_stats.pending;
+	// head_time is from the last batch, records put since then are newer
+	stats->lag           = rb_stats.pending != 0 && head_time != 0 && now > head_time ? now - head_time : 0;
+	stats->evicted       = rb_stats.evicted;
+	stats->evicted_bytes = rb_stats.evicted_bytes;
+	stats->connects      = c->connects;
+	stats->disconnects   = c->disconnects;
+	stats->send_bytes    = c->send_bytes;
+}
+
+int NetLoggingMgrGetStats(NetLoggingMgrStats_t *stats){
+
+	int res;
+	uint32_t state;
+	ringbuf_stats rb_stats;
+	spill_stats sp_stats;
+	filter_stats ft_stats;
+	NetLoggingMgrStats_t k_stats;
+
+	ENTER_SYSCALL(state);
+
+	if(log_ring != NULL){
+		ringbuf_get_stats(log_ring, &rb_stats);
+	}else{
+		memset(&rb_stats, 0, sizeof(rb_stats));
+	}
+	spill_get_stats(&sp_stats);
+	filter_get_stats(&ft_stats);
+
+	memset(&k_stats, 0, sizeof(k_stats));
+	k_stats.ring_size     = rb_stats.size;
+	k_stats.hwm           = rb_stats.hwm;
+	k_stats.time_above_80 = rb_stats.time_above_80;
+	k_stats.evicted       = rb_stats.evicted;
+	k_stats.evicted_bytes = rb_stats.evicted_bytes;
+	k_stats.dropped       = rb_stats.dropped;
+	k_stats.dropped_bytes = rb_stats.dropped_bytes;
+	k_stats.blocked             = rb_stats.blocked;
+	k_stats.block_timeouts      = rb_stats.block_timeouts;
+	k_stats.block_timeout_bytes = rb_stats.block_timeout_bytes;
+	k_stats.block_time          = rb_stats.block_time;
+	k_stats.wakeups             = rb_stats.wakeups;
+	k_stats.spilled_bytes       = sp_stats.spilled_bytes;
+	k_stats.replayed_bytes      = sp_stats.replayed_bytes;
+	k_stats.spill_lost_bytes    = sp_stats.lost_bytes;
+	k_stats.spill_errors        = sp_stats.errors;
+	k_stats.connects            = net_server.connects;
+	k_stats.connect_failures    = net_server.connect_failures;
+	k_stats.disconnects         = net_server.disconnects;
+	k_stats.connect_time_last   = net_server.connect_time_last;
+	k_stats.connect_time_max    = net_server.connect_time_max;
+	k_stats.connect_time_total  = net_server.connect_time_total;
+	k_stats.lz_blocks           = net_server.lz_blocks;
+	k_stats.lz_fallbacks        = net_server.lz_fallbacks;
+	k_stats.lz_in_bytes         = net_server.lz_in_bytes;
+	k_stats.lz_out_bytes        = net_server.lz_out_bytes;
+	k_stats.lz_time             = net_server.lz_time;
+	k_stats.sends               = net_server.sends;
+	k_stats.send_bytes          = net_server.send_bytes;
+	k_stats.batches             = net_server.batches;
+	k_stats.batch_recs          = net_server.batch_recs;
+	k_stats.filtered            = ft_stats.dropped;
+	k_stats.filter_modules      = filter_modules;
+
+	for(int i = 0; i < NLM_DEST_MAX; i++){
+		net_conn *c = __atomic_load_n(&net_conns[i], __ATOMIC_ACQUIRE);
+
+		if(c != NULL && c->ring != NULL){
+			dest_get_stats(c, &k_stats.dest[i]);
+		}
+	}
+
+	res = ksceKernelMemcpyKernelToUser((uintptr_t)stats, &k_stats, sizeof(NetLoggingMgrStats_t));
 	if(res < 0){
 		goto end;
 	}
@@ -305,6 +1828,38 @@ end:
 	return res;
 }
 
+int NetLoggingMgrDumpRecent(char *buf, unsigned int size){
+
+	static char snapshot[NLM_RECENT_SIZE];
+	static int snapshot_busy = 0;
+	int expect = 0;
+	int res;
+	uint32_t state;
+
+	ENTER_SYSCALL(state);
+
+	// one dump at a time, the snapshot buffer is shared
+	if(!__atomic_compare_exchange_n(&snapshot_busy, &expect, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)){
+		res = -1;
+		goto end;
+	}
+
+	res = flightrec_snapshot(snapshot, size < sizeof(snapshot) ? size : sizeof(snapshot), logrec_text);
+	if(res > 0){
+		int copy_res = ksceKernelMemcpyKernelToUser((uintptr_t)buf, snapshot, res);
+		if(copy_res < 0){
+			res = copy_res;
+		}
+	}
+
+	__atomic_store_n(&snapshot_busy, 0, __ATOMIC_RELEASE);
+
+end:
+	EXIT_SYSCALL(state);
+
+	return res;
+}
+
 
 
 int NetLoggingMgrLoadConfigForKernel(void){
@@ -312,6 +1867,7 @@ int NetLoggingMgrLoadConfigForKernel(void){
 	int res;
 	SceUID fd;
 	const char magic[4] = {'N', 'L', 'M', '\0'};
+	NetLoggingMgrConfig_t config;
 
 
 
@@ -329,18 +1885,21 @@ int NetLoggingMgrLoadConfigForKernel(void){
 		res = fd;
 		goto end;
 	}
-	res = ksceIoRead(fd, &NetLoggingMgrConfig, sizeof(NetLoggingMgrConfig_t));
-	if(res != sizeof(NetLoggingMgrConfig_t)){
+	// older config files are shorter, missing fields read as zero
+	memset(&config, 0, sizeof(config));
+	res = ksceIoRead(fd, &config, sizeof(config));
+	if(res < NLM_CONFIG_MIN_SIZE){
 		res = -1;
 		goto end;
 	}
 
-	if(memcmp(&NetLoggingMgrConfig, &magic, 4) != 0){
+	if(memcmp(&config, magic, 4) != 0){
 		res = SCE_KERNEL_ERROR_ILLEGAL_TYPE;
-		res = 0;
 		goto end;
 	}
 
+	memcpy(&NetLoggingMgrConfig, &config, sizeof(config));
+
 	server.sin_addr.s_addr = NetLoggingMgrConfig.IPv4;
 	server.sin_port = ksceNetHtons(NetLoggingMgrConfig.port ? NetLoggingMgrConfig.port : DEFAULT_PORT);
 	
@@ -348,6 +1907,12 @@ int NetLoggingMgrLoadConfigForKernel(void){
 
 	NetLoggingMgrFlags |= NLM_BIT_CONFIG_LOADED;
 
+	if(NetLoggingMgrFlags & NLM_BIT_INIT){
+		config_rings();
+		config_filter();
+		config_dests();
+	}
+
 end:
 	if(fd > 0){
 		ksceIoClose(fd);
@@ -367,12 +1932,20 @@ int NetLoggingMgrFinish(void){
 
 	if(net_thread_run != 0){
 		net_thread_run = 0;
-		ksceKernelWaitThreadEnd(net_thread_uid, NULL, NULL);
+		for(int i = 0; i < NLM_DEST_MAX; i++){
+			net_conn *c = net_conns[i];
+
+			if(c != NULL && c->thread_uid > 0){
+				ringbuf_wake(c->ring);
+				ksceKernelWaitThreadEnd(c->thread_uid, NULL, NULL);
+			}
+		}
 	}
 
 	if(net_thread_uid > 0){
 		ksceKernelDeleteThread(net_thread_uid);
 		net_thread_uid = 0;
+		net_server.thread_uid = 0;
 	}
 
 	HookRelease(hook_uid[0x00], SceQafMgrForDriver_382C71E8);
@@ -381,7 +1954,18 @@ int NetLoggingMgrFinish(void){
 
 	sceDebugRegisterPutcharHandlerForKernel(0, 0);
 
-	ringbuf_term();
+	for(int i = 1; i < NLM_DEST_MAX; i++){
+		if(net_conns[i] != NULL){
+			dest_ring[i - 1] = NULL;
+			dest_thread_uid[i - 1] = 0;
+			dest_destroy(net_conns[i]);
+			net_conns[i] = NULL;
+		}
+	}
+
+	ringbuf_destroy(log_ring);
+	log_ring = NULL;
+	net_server.ring = NULL;
 
 	NetLoggingMgrFlags &= ~NLM_BIT_INIT;
 
@@ -405,11 +1989,17 @@ int NetLoggingMgrInit(void){
 		goto end;
 	}
 
-	ret = ringbuf_init(RINGBUF_LEN);
-	if (ret < 0) {
+	log_ring = ringbuf_create(config_ring_size(), RINGBUF_FLAG_MIRRORED);
+	if (log_ring == NULL) {
+		ret = -1;
 		goto end;
 	}
 
+	net_server.ring = log_ring;
+	config_wakeup(log_ring);
+	linebuf_init(log_ring, log_put_user);
+	spill_init("ur0:data");
+
 	if(GetExport("SceKernelModulemgr", 0xC445FA63, 0x97CF7B4E, &sceKernelGetModuleListForKernel) < 0)
 	if(GetExport("SceKernelModulemgr", 0x92C9FFC2, 0xB72C75A4, &sceKernelGetModuleListForKernel) < 0){
 		ret = -1;
@@ -451,6 +2041,8 @@ int NetLoggingMgrInit(void){
 		goto end;
 	}
 
+	config_filter();
+
 	hook_uid[0x00] = HookExport("SceSysmem", 0xFFFFFFFF, 0x382C71E8, SceQafMgrForDriver_382C71E8);
 
 	ret = sceDebugDisableInfoDumpForKernel(0);
@@ -470,10 +2062,16 @@ int NetLoggingMgrInit(void){
 		ret = net_thread_uid;
 		goto end;
 	}
+	net_server.thread_uid = net_thread_uid;
 
 	net_thread_run = 1;
 
-	ksceKernelStartThread(net_thread_uid, 0, NULL);
+	ksceKernelStartThread(net_thread_uid, sizeof(net_conns[0]), &net_conns[0]);
+
+	ret = config_dests();
+	if(ret < 0){
+		goto end;
+	}
 
 	ret = 0;
 
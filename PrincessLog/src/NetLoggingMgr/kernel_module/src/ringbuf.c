@@ -16,209 +16,1218 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
 #include "ringbuf.h"
-#include <psp2kern/kernel/sysmem.h>
-#include <psp2kern/kernel/threadmgr.h>
+#include "ringbuf_os.h"
 
-#define SCE_KERNEL_ATTR_SINGLE			(0x00000000U)	/**< 複数のスレッドが同時に待機できない(イベントフラグのみ) */
-#define SCE_KERNEL_ATTR_MULTI			(0x00001000U)	/**< 複数のスレッドが同時に待機できる(イベントフラグのみ) */
-#define SCE_KERNEL_ATTR_TH_FIFO			(0x00000000U)	/**< 待機スレッドのキューイングはFIFO */
-#define SCE_KERNEL_ATTR_TH_PRIO			(0x00002000U)	/**< 待機スレッドのキューイングはスレッドの優先度順 */
+#define RINGBUF_EVF_NON_EMPTY 0x00000001
+#define RINGBUF_EVF_SPACE 0x00000002
+#define RINGBUF_EVF_WAKE 0x00000004
+
+// how often the consumer looks at an old set that still has writers
+#define RINGBUF_DRAIN_POLL_US 1000
+
+/*
+ * One ring per CPU core so producers on different cores never touch the
+ * same indices or cache lines. net_thread merges the rings by record
+ * timestamp. Anything that happened-before a record was committed before
+ * that record's timestamp was taken, so merging only committed records
+ * keeps causal order without waiting for records still being written.
+ */
+#define RINGBUF_NCPU 4
+#define RINGBUF_CACHE_LINE 64
 
-#define SCE_KERNEL_MUTEX_ATTR_TH_FIFO			SCE_KERNEL_ATTR_TH_FIFO	/**< ミューテックスの待機スレッドのキューイングはFIFO */
-#define SCE_KERNEL_MUTEX_ATTR_TH_PRIO			SCE_KERNEL_ATTR_TH_PRIO	/**< ミューテックスの待機スレッドのキューイングはスレッドの優先度順 */
-#define SCE_KERNEL_MUTEX_ATTR_RECURSIVE			(0x00000002U)			/**< ミューテックスは再帰ロック可能 */
-#define SCE_KERNEL_MUTEX_ATTR_CEILING			(0x00000004U)			/**< ミューテックスの優先度シーリング機能を使用する */
+/*
+ * Records are 8 byte aligned and laid out as a rec_hdr followed by the
+ * payload. Producers reserve space by CAS on head_pos and publish a
+ * record by storing its position into the matching commit tag.
+ * A committed tag holds the record position (a multiple of 8); claiming
+ * (consumer) or evicting (clobbering producer) it is a CAS to an odd
+ * value, so exactly one side wins. Tags are reset to FREE once tail_pos
+ * has moved past them, so a stale tag can never look committed.
+ */
+#define RINGBUF_REC_ALIGN 8
 
-#define SCE_KERNEL_EVF_ATTR_TH_FIFO		SCE_KERNEL_ATTR_TH_FIFO		/**< イベントフラグの待機スレッドのキューイングはFIFO */
-#define SCE_KERNEL_EVF_ATTR_TH_PRIO		SCE_KERNEL_ATTR_TH_PRIO		/**< イベントフラグの待機スレッドのキューイングはスレッドの優先度順 */
-#define SCE_KERNEL_EVF_ATTR_SINGLE		SCE_KERNEL_ATTR_SINGLE	/**< 複数のスレッドが同時に待機できない */
-#define SCE_KERNEL_EVF_ATTR_MULTI		SCE_KERNEL_ATTR_MULTI	/**< 複数のスレッドが同時に待機できる */
+#define RINGBUF_MIN_LEN 0x1000
 
-#define SCE_KERNEL_EVF_WAITMODE_AND			(0x00000000U)	/**< AND 待ち */
-#define SCE_KERNEL_EVF_WAITMODE_OR			(0x00000001U)	/**< OR 待ち */
-#define SCE_KERNEL_EVF_WAITMODE_CLEAR_ALL	(0x00000002U)	/**< 待ち成立後、すべてのビットをクリア  */
-#define SCE_KERNEL_EVF_WAITMODE_CLEAR_PAT	(0x00000004U)	/**< 待ち成立後、bitPatternに指定したビットをクリア */
+#define RINGBUF_TAG_CLAIMED 1
+#define RINGBUF_TAG_EVICTED 3
+#define RINGBUF_TAG_FREE 7
 
-#define RINGBUF_EVF_NON_EMPTY 0x00000001
+// what put() does when the ring is full
+#define RINGBUF_PUT_DROP 0	// refuse the new record and count it
+#define RINGBUF_PUT_CLOBBER 1	// evict the oldest records
+#define RINGBUF_PUT_TRY 2	// refuse without counting, the caller retries
+
+#define load_acquire(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define store_release(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define cas(p, expect, v) ({ \
+	__typeof__(*(p)) _expect = (expect); \
+	__atomic_compare_exchange_n((p), &_expect, (v), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE); \
+})
+
+void *memcpy(void *dst, const void *src, size_t n);
+void *memset(void *dst, int ch, size_t n);
+void *memmove(void *dst, const void *src, size_t n);
+int snprintf(char *s, size_t n, const char *fmt, ...);
+
+typedef struct rec_hdr {
+	unsigned int len;	// first word, never split by the wrap
+	unsigned int cpu;
+	SceUInt64 time;
+} rec_hdr;
+
+typedef struct ring {
+	SceUID memblock_uid;
+	SceUID tag_uid;		// tags get their own block when the data is mirrored
+
+	/*
+	 * buf_len is always a power of two so positions wrap with a mask.
+	 * Positions run freely and are only masked when touching memory.
+	 */
+	unsigned int buf_len;
+	unsigned int buf_mask;
+	char *base_ptr;
+	unsigned int *tag_ptr;
+	int mirrored;		// base_ptr + buf_len maps the same pages again
+
+	// written by producers
+	unsigned int head_pos __attribute__((aligned(RINGBUF_CACHE_LINE)));	// next position to reserve
+	unsigned int writers;		// producers inside put(), see set_enter(); never reset
+	unsigned int above_since;	// low time bits | 1 while above 80% full
+	unsigned int hwm;
+
+	// written by the consumer, and by producers only when evicting
+	unsigned int tail_pos __attribute__((aligned(RINGBUF_CACHE_LINE)));	// oldest record still owned by the ring
+
+	/*
+	 * consumer private: records from tail_pos up to cons_pos are claimed
+	 * and waiting for ringbuf_commit(). While any are, producers cannot
+	 * evict from this ring, so cons_pos is only ours to move.
+	 */
+	unsigned int cons_pos;
+	int n_claimed;
+	SceUInt64 time_above_80;
+} ring;
+
+/*
+ * Resizing swaps in a new set of rings. Producers move to the new set at
+ * once while the consumer keeps draining the old one, and frees it once
+ * it is empty and no producer is still writing into it.
+ */
+typedef struct ring_set {
+	ring rings[RINGBUF_NCPU];
+	unsigned int size;
+} ring_set;
+
+/*
+ * Records handed out by ringbuf_peek() and not yet fully committed, in
+ * merge order. A record without a ring is the drop marker.
+ */
+typedef struct inflight_rec {
+	ring *r;
+	unsigned int pos;
+	unsigned int len;
+	unsigned int off;	// bytes already committed
+	SceUInt64 time;
+} inflight_rec;
+
+#define RINGBUF_MAX_INFLIGHT 32
+
+struct ringbuf {
+	SceUID memblock_uid;
+	SceUID evf_uid;
+	unsigned int flags;	// RINGBUF_FLAG_*, also used for the rings of a resize
+
+	ring_set sets[2];
+	ring_set *cur_set;	// where producers write
+	ring_set *old_set;	// being drained after a resize
+	int resizing;
 
-static SceUID evf_uid = -1;
-static SceUID mtx_uid = -1;
-static SceUID memblock_uid = -1;
+	// lifetime loss and wait counters, kept outside the sets so resizes never lose them
+	ringbuf_stats totals;
 
-static int buf_len = 0;
-static char *base_ptr = NULL;
-static char *get_ptr = NULL;
-static char *put_ptr = NULL;
+	// producers waiting in ringbuf_put_wait() for the consumer to free space
+	int n_waiting;
 
-static int idx(char *ptr) {
-	return (unsigned int)ptr % buf_len;
+	/*
+	 * Producers only wake the consumer when their ring fills past the
+	 * watermark, or when the consumer sleeps without a deadline because
+	 * nothing was waiting. Otherwise it wakes by itself once the oldest
+	 * record is wake_latency old, so small puts are sent in batches.
+	 */
+	unsigned int wake_watermark;
+	SceUInt wake_latency;
+	int consumer_idle;
+
+	// consumer private
+	inflight_rec inflight[RINGBUF_MAX_INFLIGHT] __attribute__((aligned(RINGBUF_CACHE_LINE)));
+	int n_inflight;
+
+	char marker_buf[0x40];
+	int marker_queued;	// marker_buf is in flight, do not reuse it
+	unsigned int marker_lost;	// what marker_buf announces
+	unsigned int marker_lost_bytes;
+	unsigned int lost_seen, lost_bytes_seen;
+};
+
+static unsigned int pow2_roundup(unsigned int n) {
+	n--;
+	n |= n >> 1;
+	n |= n >> 2;
+	n |= n >> 4;
+	n |= n >> 8;
+	n |= n >> 16;
+	return n + 1;
 }
 
-static void inc(char **ptr) {
-	*ptr = base_ptr + idx(*ptr + 1);
+static unsigned int rec_len(unsigned int len) {
+	return (sizeof(rec_hdr) + len + RINGBUF_REC_ALIGN - 1) & ~(RINGBUF_REC_ALIGN - 1);
 }
 
-static int empty(void) {
-	return get_ptr == put_ptr;
+static unsigned int *tag(ring *r, unsigned int pos) {
+	return &r->tag_ptr[(pos & r->buf_mask) / RINGBUF_REC_ALIGN];
 }
 
-static int full(void) {
-	return idx(put_ptr + 1) == idx(get_ptr);
+static unsigned int *hdr_len(ring *r, unsigned int pos) {
+	return (unsigned int *)(r->base_ptr + (pos & r->buf_mask));
 }
 
-static int put(char c) {
-	if (full()) {
-		return -1;
+// copy in/out as at most two segments split at the end of the buffer
+static void copy_in(ring *r, unsigned int pos, const void *src, unsigned int len) {
+	unsigned int off = pos & r->buf_mask;
+	unsigned int first = r->buf_len - off;
+
+	if (r->mirrored || first >= len) {
+		memcpy(r->base_ptr + off, src, len);
+	} else {
+		memcpy(r->base_ptr + off, src, first);
+		memcpy(r->base_ptr, (const char *)src + first, len - first);
+	}
+}
+
+static void copy_out(ring *r, void *dst, unsigned int pos, unsigned int len) {
+	unsigned int off = pos & r->buf_mask;
+	unsigned int first = r->buf_len - off;
+
+	if (r->mirrored || first >= len) {
+		memcpy(dst, r->base_ptr + off, len);
+	} else {
+		memcpy(dst, r->base_ptr + off, first);
+		memcpy((char *)dst + first, r->base_ptr, len - first);
+	}
+}
+
+// move tail_pos past an evicted record; anyone may finish an eviction
+static void advance_evicted(ringbuf *rb, ring *r, unsigned int t, unsigned int len) {
+	if (cas(&r->tail_pos, t, t + rec_len(len))) {
+		cas(tag(r, t), t | RINGBUF_TAG_EVICTED, RINGBUF_TAG_FREE);
+		__atomic_add_fetch(&rb->totals.evicted, 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&rb->totals.evicted_bytes, len, __ATOMIC_RELAXED);
+	}
+}
+
+/*
+ * Drop the oldest record to make room. Fails when the oldest record is
+ * still being written or is held by the consumer; the caller then drops
+ * its own record instead of waiting.
+ */
+static int evict(ringbuf *rb, ring *r) {
+	unsigned int t = load_acquire(&r->tail_pos);
+	unsigned int tg = load_acquire(tag(r, t));
+	unsigned int len;
+
+	if (tg != t && tg != (t | RINGBUF_TAG_EVICTED)) {
+		return load_acquire(&r->tail_pos) != t ? 0 : -1;
 	}
-	*put_ptr = c;
-	inc(&put_ptr);
+
+	// stays valid until tail_pos moves, and then the tail CAS fails anyway
+	len = *hdr_len(r, t);
+	if (tg == t && !cas(tag(r, t), t, t | RINGBUF_TAG_EVICTED)) {
+		return 0;
+	}
+	advance_evicted(rb, r, t, len);
 	return 0;
 }
 
-static int put_clobber(char c) {
-	if (full()) {
-		inc(&get_ptr);
+/*
+ * Pin the ring of the current core in the current set. The writer count
+ * is per ring so it stays on this core's cache line.
+ */
+static ring *set_enter(ringbuf *rb, unsigned int cpu) {
+	for (;;) {
+		ring_set *set = __atomic_load_n(&rb->cur_set, __ATOMIC_SEQ_CST);
+		ring *r;
+
+		if (set == NULL) {
+			return NULL;
+		}
+		r = &set->rings[cpu];
+		__atomic_add_fetch(&r->writers, 1, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&rb->cur_set, __ATOMIC_SEQ_CST) == set) {
+			return r;
+		}
+		__atomic_sub_fetch(&r->writers, 1, __ATOMIC_RELEASE);
+	}
+}
+
+static void set_leave(ring *r) {
+	__atomic_sub_fetch(&r->writers, 1, __ATOMIC_RELEASE);
+}
+
+static void track_fill(ring *r, unsigned int used) {
+	unsigned int hwm = load_acquire(&r->hwm);
+
+	while (used > hwm && !__atomic_compare_exchange_n(&r->hwm, &hwm, used,
+		0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+
+	if (used > r->buf_len / 5 * 4 && load_acquire(&r->above_since) == 0) {
+		cas(&r->above_since, 0, (unsigned int)os_time_us() | 1);
 	}
-	*put_ptr = c;
-	inc(&put_ptr);
+}
+
+static void notify(ringbuf *rb, ring *r, unsigned int before, unsigned int after) {
+	unsigned int watermark = rb->wake_watermark;
+
+	if (watermark > r->buf_len / 2) {
+		watermark = r->buf_len / 2;
+	}
+	if (before < watermark && after >= watermark) {
+		goto wake;
+	}
+
+	// pairs with ringbuf_peek_wait(): the record is published before we look
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&rb->consumer_idle, __ATOMIC_RELAXED) && cas(&rb->consumer_idle, 1, 0)) {
+		goto wake;
+	}
+	return;
+
+wake:
+	__atomic_add_fetch(&rb->totals.wakeups, 1, __ATOMIC_RELAXED);
+	os_event_set(rb->evf_uid, RINGBUF_EVF_NON_EMPTY);
+}
+
+static unsigned int spans_len(const ringbuf_span *span, int n_span) {
+	unsigned int len = 0;
+
+	for (int i = 0; i < n_span; i++) {
+		len += span[i].len;
+	}
+	return len;
+}
+
+/*
+ * The record is the concatenation of the src spans, stamped with time.
+ * Returns its length, -1 if the ring is full, or -2 if the record can
+ * never fit.
+ */
+static int put(ringbuf *rb, const ringbuf_span *src, int n_src, SceUInt64 time, int mode) {
+	unsigned int need, h, t, pos;
+	unsigned int len = spans_len(src, n_src);
+	unsigned int max_len, skip = 0;
+	rec_hdr hdr;
+	ring *r;
+
+	hdr.cpu = os_cpu_id() & (RINGBUF_NCPU - 1);
+	hdr.time = time;
+
+	// a migrated thread may land on another core's ring, which is still safe
+	r = set_enter(rb, hdr.cpu);
+	if (r == NULL) {
+		return -1;
+	}
+
+	max_len = r->buf_len - rec_len(0);
+	if (len > max_len) {
+		if (mode != RINGBUF_PUT_CLOBBER) {
+			goto too_big;
+		}
+		// only the tail end of an oversized write can survive anyway
+		skip = len - max_len;
+		len = max_len;
+	}
+	hdr.len = len;
+	need = rec_len(len);
+
+	for (;;) {
+		// tail first: tail never passes head, so head - tail cannot underflow
+		t = load_acquire(&r->tail_pos);
+		h = load_acquire(&r->head_pos);
+		if (h + need - t <= r->buf_len) {
+			if (cas(&r->head_pos, h, h + need)) {
+				break;
+			}
+			continue;
+		}
+		if (mode == RINGBUF_PUT_CLOBBER && evict(rb, r) == 0) {
+			continue;
+		}
+		goto full;
+	}
+
+	copy_in(r, h, &hdr, sizeof(hdr));
+	pos = h + sizeof(hdr);
+	for (int i = 0; i < n_src; i++) {
+		if (skip >= src[i].len) {
+			skip -= src[i].len;
+			continue;
+		}
+		copy_in(r, pos, src[i].ptr + skip, src[i].len - skip);
+		pos += src[i].len - skip;
+		skip = 0;
+	}
+	store_release(tag(r, h), h);
+	track_fill(r, h + need - t);
+	set_leave(r);
+
+	notify(rb, r, h - t, h + need - t);
+	return len;
+
+too_big:
+	if (mode == RINGBUF_PUT_TRY) {
+		set_leave(r);
+		return -2;
+	}
+full:
+	if (mode != RINGBUF_PUT_TRY) {
+		__atomic_add_fetch(&rb->totals.dropped, 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&rb->totals.dropped_bytes, len, __ATOMIC_RELAXED);
+	}
+	set_leave(r);
+	return -1;
+}
+
+// next position the consumer would claim from
+static unsigned int cons_next(ring *r) {
+	return r->n_claimed ? r->cons_pos : load_acquire(&r->tail_pos);
+}
+
+/*
+ * Look at the next committed record of a ring without claiming it.
+ * If it is at the tail it may be evicted under us, which claim() handles.
+ */
+static int peek_time(ring *r, SceUInt64 *time) {
+	unsigned int t = cons_next(r);
+	rec_hdr hdr;
+
+	if (load_acquire(tag(r, t)) != t) {
+		return -1;
+	}
+	copy_out(r, &hdr, t, sizeof(hdr));
+	*time = hdr.time;
+
+	// re-check so a record evicted during the copy is not trusted
+	return cons_next(r) == t ? 0 : -1;
+}
+
+// claim the next record of a ring for the consumer
+static int claim(ringbuf *rb, ring *r, unsigned int *pos, unsigned int *len) {
+	unsigned int t, tg;
+
+	if (r->n_claimed) {
+		// nobody can evict past our claimed tail record
+		t = r->cons_pos;
+		if (!cas(tag(r, t), t, t | RINGBUF_TAG_CLAIMED)) {
+			return -1;
+		}
+		*len = *hdr_len(r, t);
+		goto claimed;
+	}
+
+	for (;;) {
+		t = load_acquire(&r->tail_pos);
+		tg = load_acquire(tag(r, t));
+		if (tg == (t | RINGBUF_TAG_EVICTED)) {
+			advance_evicted(rb, r, t, *hdr_len(r, t));
+			continue;
+		}
+		if (tg != t) {
+			if (load_acquire(&r->tail_pos) != t) {
+				continue;
+			}
+			return -1;
+		}
+		*len = *hdr_len(r, t);
+		if (cas(tag(r, t), t, t | RINGBUF_TAG_CLAIMED)) {
+			break;
+		}
+		// lost to an evicting producer, help it finish
+		advance_evicted(rb, r, t, *len);
+	}
+
+claimed:
+	*pos = t;
+	r->cons_pos = t + rec_len(*len);
+	r->n_claimed++;
 	return 0;
 }
 
-static int get(char *c) {
-	if (empty()) {
+// hand a fully sent record back to the producers, always the ring tail
+static void release(ring *r, unsigned int t, unsigned int len) {
+	unsigned int since;
+
+	r->n_claimed--;
+	store_release(tag(r, t), RINGBUF_TAG_FREE);
+	store_release(&r->tail_pos, t + rec_len(len));
+
+	since = load_acquire(&r->above_since);
+	if (since != 0 && load_acquire(&r->head_pos) - (t + rec_len(len)) <= r->buf_len / 5 * 4) {
+		if (cas(&r->above_since, since, 0)) {
+			r->time_above_80 += (unsigned int)os_time_us() - since;
+		}
+	}
+}
+
+// k-way merge step: the ring holding the oldest committed record
+static ring *oldest_in(ring_set *set) {
+	ring *best = NULL;
+	SceUInt64 best_time = 0, time;
+
+	for (int i = 0; i < RINGBUF_NCPU; i++) {
+		if (peek_time(&set->rings[i], &time) == 0 && (best == NULL || time < best_time)) {
+			best = &set->rings[i];
+			best_time = time;
+		}
+	}
+
+	return best;
+}
+
+static void set_term(ring_set *set);
+
+// records of a set replaced by a resize all go out before the new ones
+static ring *oldest(ringbuf *rb) {
+	ring_set *set = load_acquire(&rb->old_set);
+	ring *r;
+
+	if (set != NULL) {
+		r = oldest_in(set);
+		if (r != NULL) {
+			return r;
+		}
+		// pairs with set_enter(): once the switch is seen, late writers are counted
+		if (__atomic_load_n(&rb->cur_set, __ATOMIC_SEQ_CST) == set) {
+			return NULL;
+		}
+		for (int i = 0; i < RINGBUF_NCPU; i++) {
+			if (set->rings[i].n_claimed || __atomic_load_n(&set->rings[i].writers, __ATOMIC_SEQ_CST)) {
+				return NULL;
+			}
+		}
+		// a writer that just left may have committed one last record
+		r = oldest_in(set);
+		if (r != NULL) {
+			return r;
+		}
+		set_term(set);
+		store_release(&rb->old_set, NULL);
+	}
+
+	return oldest_in(load_acquire(&rb->cur_set));
+}
+
+/*
+ * Announce records lost since the last marker with a single line, so the
+ * reader knows where the gap is without receiving partial messages.
+ */
+static int queue_lost_marker(ringbuf *rb) {
+	ringbuf_stats stats;
+	unsigned int lost, lost_bytes;
+	int len;
+
+	if (rb->marker_queued) {
+		return -1;
+	}
+
+	ringbuf_get_stats(rb, &stats);
+	lost = stats.evicted + stats.dropped + stats.block_timeouts - rb->lost_seen;
+	lost_bytes = stats.evicted_bytes + stats.dropped_bytes + stats.block_timeout_bytes - rb->lost_bytes_seen;
+	if (lost == 0) {
+		return -1;
+	}
+
+	len = snprintf(rb->marker_buf, sizeof(rb->marker_buf),
+		"\n[NetLoggingMgr] %u records dropped (%u bytes)\n", lost, lost_bytes);
+	if (len < 0) {
 		return -1;
 	}
-	*c = *get_ptr;
-	inc(&get_ptr);
+	if (len >= (int)sizeof(rb->marker_buf)) {
+		len = sizeof(rb->marker_buf) - 1;
+	}
+	rb->lost_seen += lost;
+	rb->lost_bytes_seen += lost_bytes;
+	rb->marker_lost = lost;
+	rb->marker_lost_bytes = lost_bytes;
+
+	rb->inflight[rb->n_inflight].r = NULL;
+	rb->inflight[rb->n_inflight].pos = 0;
+	rb->inflight[rb->n_inflight].len = len;
+	rb->inflight[rb->n_inflight].off = 0;
+	rb->inflight[rb->n_inflight].time = os_time_us();
+	rb->n_inflight++;
+	rb->marker_queued = 1;
 	return 0;
 }
 
-int ringbuf_init(int size) {
-	int ret = 0;
+static int queue_next(ringbuf *rb) {
+	inflight_rec *rec = &rb->inflight[rb->n_inflight];
+	rec_hdr hdr;
+	ring *r;
 
-	evf_uid = ksceKernelCreateEventFlag("RingBufferEventFlag",
-		SCE_KERNEL_ATTR_TH_FIFO | SCE_KERNEL_EVF_ATTR_MULTI,
-		0x00000000,
-		NULL);
-	if (evf_uid < 0) {
-		ret = evf_uid;
-		goto fail_evf;
+	// the marker goes in front of the first record after a loss
+	if (queue_lost_marker(rb) == 0) {
+		return 0;
+	}
+
+	for (;;) {
+		r = oldest(rb);
+		if (r == NULL) {
+			return -1;
+		}
+		if (claim(rb, r, &rec->pos, &rec->len) == 0) {
+			break;
+		}
+	}
+	copy_out(r, &hdr, rec->pos, sizeof(hdr));
+	rec->r = r;
+	rec->off = 0;
+	rec->time = hdr.time;
+	rb->n_inflight++;
+	return 0;
+}
+
+// unsent part of a record as one span, or two if it wraps
+static int rec_spans(ringbuf *rb, const inflight_rec *rec, ringbuf_span *span) {
+	unsigned int off, first;
+
+	if (rec->r == NULL) {
+		span[0].ptr = rb->marker_buf + rec->off;
+		span[0].len = rec->len - rec->off;
+		return 1;
 	}
 
-	mtx_uid = ksceKernelCreateMutex("RingBufferMutex", SCE_KERNEL_MUTEX_ATTR_TH_FIFO, 0, NULL);
-	if (mtx_uid < 0) {
-		ret = mtx_uid;
-		goto fail_mtx;
+	off = (rec->pos + sizeof(rec_hdr) + rec->off) & rec->r->buf_mask;
+	first = rec->r->buf_len - off;
+	span[0].ptr = rec->r->base_ptr + off;
+	if (rec->r->mirrored || first >= rec->len - rec->off) {
+		span[0].len = rec->len - rec->off;
+		return 1;
+	}
+	span[0].len = first;
+	span[1].ptr = rec->r->base_ptr;
+	span[1].len = rec->len - rec->off - first;
+	return 2;
+}
+
+static int ring_init(ring *r, int size, unsigned int flags) {
+	int tag_len = size / RINGBUF_REC_ALIGN * sizeof(*r->tag_ptr);
+
+	r->tag_uid = -1;
+	r->mirrored = 0;
+	if (flags & RINGBUF_FLAG_MIRRORED) {
+		r->base_ptr = os_mem_alloc_mirrored("RingBufferMemBlock", size, &r->memblock_uid);
+		if (r->base_ptr != NULL) {
+			r->tag_ptr = os_mem_alloc("RingBufferTagBlock", tag_len, &r->tag_uid);
+			if (r->tag_ptr == NULL) {
+				os_mem_free(r->memblock_uid);
+				return r->tag_uid < 0 ? r->tag_uid : -1;
+			}
+			r->mirrored = 1;
+		}
+		// not every backend can map pages twice, the plain layout works everywhere
 	}
 
-	memblock_uid = ksceKernelAllocMemBlock("RingBufferMemBlock", 0x6020D006, size, NULL);
-	if (memblock_uid < 0) {
-		ret = memblock_uid;
-		goto fail_memblock;
+	if (!r->mirrored) {
+		r->base_ptr = os_mem_alloc("RingBufferMemBlock", size + tag_len, &r->memblock_uid);
+		if (r->base_ptr == NULL) {
+			return r->memblock_uid < 0 ? r->memblock_uid : -1;
+		}
+		r->tag_ptr = (unsigned int *)(r->base_ptr + size);
 	}
-	ksceKernelGetMemBlockBase(memblock_uid, (void**)&base_ptr);
 
-	buf_len = size;
-	get_ptr = put_ptr = base_ptr;
+	r->buf_len = size;
+	r->buf_mask = size - 1;
+	for (int i = 0; i < size / RINGBUF_REC_ALIGN; i++) {
+		r->tag_ptr[i] = RINGBUF_TAG_FREE;
+	}
+	r->head_pos = r->tail_pos = 0;
+	r->cons_pos = 0;
+	r->n_claimed = 0;
+	r->above_since = 0;
+	r->hwm = 0;
+	r->time_above_80 = 0;
 	return 0;
+}
+
+static void ring_term(ring *r) {
+	if (r->memblock_uid >= 0) {
+		os_mem_free(r->memblock_uid);
+	}
+	if (r->tag_uid >= 0) {
+		os_mem_free(r->tag_uid);
+	}
+	r->memblock_uid = -1;
+	r->tag_uid = -1;
+	r->mirrored = 0;
+	r->buf_len = r->buf_mask = 0;
+	r->base_ptr = NULL;
+	r->tag_ptr = NULL;
+	r->head_pos = r->tail_pos = 0;
+}
+
+static int set_init(ring_set *set, int size, unsigned int flags) {
+	int ret;
+	int i;
 
-fail_memblock:
-	ksceKernelDeleteMutex(mtx_uid);
-fail_mtx:
-	ksceKernelDeleteEventFlag(evf_uid);
+	for (i = 0; i < RINGBUF_NCPU; i++) {
+		ret = ring_init(&set->rings[i], size, flags);
+		if (ret < 0) {
+			goto fail_ring;
+		}
+	}
+	set->size = size;
+	return 0;
+
+fail_ring:
+	while (i-- > 0) {
+		ring_term(&set->rings[i]);
+	}
+	return ret;
+}
+
+static void set_term(ring_set *set) {
+	for (int i = 0; i < RINGBUF_NCPU; i++) {
+		ring_term(&set->rings[i]);
+	}
+	set->size = 0;
+}
+
+static unsigned int ring_size(int size) {
+	// a ring must at least hold one full kernel printf line
+	if (size < RINGBUF_MIN_LEN) {
+		size = RINGBUF_MIN_LEN;
+	}
+	return pow2_roundup(size);
+}
+
+/*
+ * size is per CPU ring.
+ */
+ringbuf *ringbuf_create(int size, unsigned int flags) {
+	ringbuf *rb;
+	SceUID memblock_uid;
+
+	if (size <= 0) {
+		return NULL;
+	}
+
+	rb = os_mem_alloc("RingBufferState", sizeof(*rb), &memblock_uid);
+	if (rb == NULL) {
+		goto fail_alloc;
+	}
+	memset(rb, 0, sizeof(*rb));
+	rb->memblock_uid = memblock_uid;
+	rb->flags = flags;
+
+	rb->evf_uid = os_event_create("RingBufferEventFlag");
+	if (rb->evf_uid < 0) {
+		goto fail_evf;
+	}
+
+	if (set_init(&rb->sets[0], ring_size(size), rb->flags) < 0) {
+		goto fail_set;
+	}
+	store_release(&rb->cur_set, &rb->sets[0]);
+	return rb;
+
+fail_set:
+	os_event_delete(rb->evf_uid);
 fail_evf:
+	os_mem_free(memblock_uid);
+fail_alloc:
+	return NULL;
+}
+
+void ringbuf_destroy(ringbuf *rb) {
+	if (rb == NULL) {
+		return;
+	}
+	store_release(&rb->cur_set, NULL);
+	os_event_delete(rb->evf_uid);
+	for (int i = 0; i < 2; i++) {
+		if (rb->sets[i].size != 0) {
+			set_term(&rb->sets[i]);
+		}
+	}
+	os_mem_free(rb->memblock_uid);
+}
+
+/*
+ * Grow or shrink the rings online. Producers switch to newly allocated
+ * rings right away; what is left in the old ones is drained by the
+ * consumer before they are freed, so nothing is lost. Fails while the
+ * rings of a previous resize are still being drained.
+ */
+int ringbuf_resize(ringbuf *rb, int size) {
+	ring_set *cur, *next;
+	int ret;
+
+	if (size <= 0) {
+		return -1;
+	}
+	size = ring_size(size);
+
+	if (!cas(&rb->resizing, 0, 1)) {
+		return -1;
+	}
+
+	cur = load_acquire(&rb->cur_set);
+	if (cur == NULL || cur->size == (unsigned int)size) {
+		ret = 0;
+		goto end;
+	}
+	if (load_acquire(&rb->old_set) != NULL) {
+		ret = -1;
+		goto end;
+	}
+
+	next = cur == &rb->sets[0] ? &rb->sets[1] : &rb->sets[0];
+	ret = set_init(next, size, rb->flags);
+	if (ret < 0) {
+		goto end;
+	}
+
+	store_release(&rb->old_set, cur);
+	__atomic_store_n(&rb->cur_set, next, __ATOMIC_SEQ_CST);
+	os_event_set(rb->evf_uid, RINGBUF_EVF_NON_EMPTY);
+	ret = 0;
+
+end:
+	store_release(&rb->resizing, 0);
 	return ret;
 }
 
-int ringbuf_term(void) {
-	ksceKernelDeleteEventFlag(evf_uid);
-	ksceKernelDeleteMutex(mtx_uid);
-	ksceKernelFreeMemBlock(memblock_uid);
-	mtx_uid = memblock_uid = -1;
-	buf_len = 0;
-	base_ptr = get_ptr = put_ptr = NULL;
-	return 0;
+int ringbuf_putv_at(ringbuf *rb, const ringbuf_span *src, int n_src, SceUInt64 time) {
+	int size = spans_len(src, n_src);
+
+	if (size <= 0) {
+		return 0;
+	}
+	return put(rb, src, n_src, time, RINGBUF_PUT_DROP) < 0 ? 0 : size;
 }
 
-int ringbuf_put(char *c, int size) {
-	int n_put = 0;
-	ksceKernelLockMutex(mtx_uid, 1, NULL);
+int ringbuf_putv_clobber_at(ringbuf *rb, const ringbuf_span *src, int n_src, SceUInt64 time) {
+	int size = spans_len(src, n_src);
 
-	while (size-- > 0) {
-		if (put(*c++) == 0) {
-			n_put++;
-		} else {
+	if (size <= 0) {
+		return 0;
+	}
+	return put(rb, src, n_src, time, RINGBUF_PUT_CLOBBER) < 0 ? 0 : size;
+}
+
+int ringbuf_putv(ringbuf *rb, const ringbuf_span *src, int n_src) {
+	return ringbuf_putv_at(rb, src, n_src, os_time_us());
+}
+
+int ringbuf_putv_clobber(ringbuf *rb, const ringbuf_span *src, int n_src) {
+	return ringbuf_putv_clobber_at(rb, src, n_src, os_time_us());
+}
+
+int ringbuf_put(ringbuf *rb, char *c, int size) {
+	ringbuf_span src = { c, size };
+
+	return ringbuf_putv(rb, &src, size > 0);
+}
+
+int ringbuf_put_clobber(ringbuf *rb, char *c, int size) {
+	ringbuf_span src = { c, size };
+
+	return ringbuf_putv_clobber(rb, &src, size > 0);
+}
+
+/*
+ * Wait up to timeout us for the consumer to make room instead of losing
+ * a record. Must not be called from the consumer thread.
+ */
+int ringbuf_putv_wait_at(ringbuf *rb, const ringbuf_span *src, int n_src, SceUInt64 time, SceUInt timeout) {
+	int size = spans_len(src, n_src);
+	SceUInt64 start, elapsed;
+	SceUInt wait;
+	int ret;
+
+	if (size <= 0) {
+		return 0;
+	}
+
+	ret = put(rb, src, n_src, time, RINGBUF_PUT_TRY);
+	if (ret != -1) {
+		goto end;
+	}
+
+	start = os_time_us();
+	__atomic_add_fetch(&rb->n_waiting, 1, __ATOMIC_SEQ_CST);
+
+	for (;;) {
+		// clear before retrying so a commit in between re-sets the flag
+		os_event_clear(rb->evf_uid, RINGBUF_EVF_SPACE);
+		ret = put(rb, src, n_src, time, RINGBUF_PUT_TRY);
+		if (ret != -1) {
+			break;
+		}
+
+		elapsed = os_time_us() - start;
+		if (elapsed >= timeout) {
 			break;
 		}
+		wait = timeout - elapsed;
+		os_event_wait(rb->evf_uid, RINGBUF_EVF_SPACE, NULL, &wait);
+	}
+
+	__atomic_sub_fetch(&rb->n_waiting, 1, __ATOMIC_SEQ_CST);
+	__atomic_add_fetch(&rb->totals.blocked, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&rb->totals.block_time, os_time_us() - start, __ATOMIC_RELAXED);
+
+end:
+	if (ret < 0) {
+		__atomic_add_fetch(&rb->totals.block_timeouts, 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&rb->totals.block_timeout_bytes, size, __ATOMIC_RELAXED);
+		return 0;
 	}
+	return size;
+}
+
+int ringbuf_putv_wait(ringbuf *rb, const ringbuf_span *src, int n_src, SceUInt timeout) {
+	return ringbuf_putv_wait_at(rb, src, n_src, os_time_us(), timeout);
+}
+
+int ringbuf_put_wait(ringbuf *rb, char *c, int size, SceUInt timeout) {
+	ringbuf_span src = { c, size };
+
+	return ringbuf_putv_wait(rb, &src, size > 0, timeout);
+}
+
+/*
+ * Zero-copy read: hand out the unsent data, oldest first, as spans that
+ * point straight into the rings. The records stay claimed, so producers
+ * cannot overwrite them, until ringbuf_commit() says they were sent.
+ * Calling again without a commit returns the same data again.
+ */
+int ringbuf_peek(ringbuf *rb, ringbuf_span *span, int n_span) {
+	int i = 0, n = 0;
 
-	if (n_put > 0) {
-		ksceKernelSetEventFlag(evf_uid, RINGBUF_EVF_NON_EMPTY);
+	// a record needs up to two spans
+	while (n_span - n >= 2) {
+		if (i == rb->n_inflight) {
+			if (rb->n_inflight == RINGBUF_MAX_INFLIGHT) {
+				break;
+			}
+			if (queue_next(rb) < 0) {
+				break;
+			}
+		}
+		n += rec_spans(rb, &rb->inflight[i++], &span[n]);
 	}
 
-	ksceKernelUnlockMutex(mtx_uid, 1);
-	return n_put;
+	return n;
 }
 
-int ringbuf_put_clobber(char *c, int size) {
-	int n_put = 0;
-	ksceKernelLockMutex(mtx_uid, 1, NULL);
+/*
+ * Like ringbuf_peek(), but one entry per record so the caller can tell
+ * where records start. Returns the number of records.
+ */
+int ringbuf_peek_recs(ringbuf *rb, ringbuf_rec *rec, int n_rec) {
+	int i;
+
+	for (i = 0; i < n_rec; i++) {
+		inflight_rec *in;
 
-	while (size-- > 0) {
-		put_clobber(*c++);
-		n_put++;
+		if (i == rb->n_inflight) {
+			if (rb->n_inflight == RINGBUF_MAX_INFLIGHT) {
+				break;
+			}
+			if (queue_next(rb) < 0) {
+				break;
+			}
+		}
+		in = &rb->inflight[i];
+		rec[i].n_span = rec_spans(rb, in, rec[i].span);
+		rec[i].len = in->len - in->off;
+		rec[i].time = in->time;
+		rec[i].marker = in->r == NULL;
+		rec[i].lost = rec[i].marker ? rb->marker_lost : 0;
+		rec[i].lost_bytes = rec[i].marker ? rb->marker_lost_bytes : 0;
 	}
 
-	if (n_put > 0) {
-		ksceKernelSetEventFlag(evf_uid, RINGBUF_EVF_NON_EMPTY);
+	return i;
+}
+
+/*
+ * Whether the unsent data is worth waking up for: at least the watermark
+ * in bytes, or a record older than wake_latency. If not, *due is when the
+ * oldest record gets too old, or 0 if there is nothing to wait for.
+ */
+static int batch_ready(ringbuf *rb, SceUInt64 now, SceUInt64 *due) {
+	ring_set *set[2] = { load_acquire(&rb->old_set), load_acquire(&rb->cur_set) };
+	unsigned int pending = 0;
+	SceUInt64 oldest = 0, time;
+	int found = 0;
+
+	*due = 0;
+
+	for (int i = 0; i < 2; i++) {
+		if (set[i] == NULL) {
+			continue;
+		}
+		for (int j = 0; j < RINGBUF_NCPU; j++) {
+			ring *r = &set[i]->rings[j];
+
+			pending += load_acquire(&r->head_pos) - cons_next(r);
+			if (peek_time(r, &time) == 0 && (!found || time < oldest)) {
+				oldest = time;
+				found = 1;
+			}
+		}
 	}
 
-	ksceKernelUnlockMutex(mtx_uid, 1);
-	return n_put;
+	if (!found) {
+		// an emptied old set is freed by peeking once its writers left
+		if (set[0] != NULL) {
+			*due = now + RINGBUF_DRAIN_POLL_US;
+		}
+		return 0;
+	}
+	if (pending >= rb->wake_watermark || now - oldest >= rb->wake_latency) {
+		return 1;
+	}
+	*due = oldest + rb->wake_latency;
+	return 0;
 }
 
-int ringbuf_get(char *c, int size) {
-	int n_get = 0;
-	ksceKernelLockMutex(mtx_uid, 1, NULL);
+/*
+ * Wait until a batch is ready to be peeked. Returns 0 on timeout or when
+ * woken by ringbuf_wake().
+ */
+int ringbuf_wait(ringbuf *rb, SceUInt *timeout) {
+	SceUInt64 start, now, due;
+	SceUInt wait;
+	unsigned int bits;
+	int ret;
 
-	while (size-- > 0) {
-		if (get(c++) == 0) {
-			n_get++;
-		} else {
+	// data handed out before and not sent yet goes again at once
+	if (rb->n_inflight > 0) {
+		return 1;
+	}
+
+	start = now = os_time_us();
+
+	for (;;) {
+		// clear before the check so a put after it leaves the flag set
+		os_event_clear(rb->evf_uid, RINGBUF_EVF_NON_EMPTY);
+		if (batch_ready(rb, now, &due)) {
 			break;
 		}
-	}
 
-	if (empty()) {
-		ksceKernelClearEventFlag(evf_uid, ~RINGBUF_EVF_NON_EMPTY);
+		if (due == 0) {
+			__atomic_store_n(&rb->consumer_idle, 1, __ATOMIC_SEQ_CST);
+			// pairs with notify(): a record put since the check is seen here
+			if (batch_ready(rb, now, &due) || due != 0) {
+				store_release(&rb->consumer_idle, 0);
+				continue;
+			}
+		}
+
+		if (timeout != NULL) {
+			if (now - start >= *timeout) {
+				return 0;
+			}
+			if (due == 0 || due > start + *timeout) {
+				due = start + *timeout;
+			}
+		}
+
+		wait = due > now ? due - now : 0;
+		ret = os_event_wait(rb->evf_uid, RINGBUF_EVF_NON_EMPTY | RINGBUF_EVF_WAKE,
+			&bits, due != 0 ? &wait : NULL);
+		store_release(&rb->consumer_idle, 0);
+		if (ret == 0 && (bits & RINGBUF_EVF_WAKE)) {
+			os_event_clear(rb->evf_uid, RINGBUF_EVF_WAKE);
+			return 0;
+		}
+		now = os_time_us();
 	}
 
-	ksceKernelUnlockMutex(mtx_uid, 1);
-	return n_get;
+	return 1;
 }
 
-int ringbuf_get_wait(char *c, int size, SceUInt *timeout) {
-	int n_get = 0;
-	int ret = ksceKernelWaitEventFlag(evf_uid,
-		RINGBUF_EVF_NON_EMPTY, SCE_KERNEL_EVF_WAITMODE_AND, NULL, timeout);
-	if (ret < 0) {
-		goto done;
+/*
+ * Like ringbuf_peek(), but first wait until a batch is ready. Returns 0 on
+ * timeout or when woken by ringbuf_wake().
+ */
+int ringbuf_peek_wait(ringbuf *rb, ringbuf_span *span, int n_span, SceUInt *timeout) {
+	if (!ringbuf_wait(rb, timeout)) {
+		return 0;
 	}
-	ksceKernelLockMutex(mtx_uid, 1, NULL);
+	return ringbuf_peek(rb, span, n_span);
+}
+
+void ringbuf_set_wakeup(ringbuf *rb, unsigned int watermark, SceUInt latency) {
+	rb->wake_watermark = watermark;
+	rb->wake_latency = latency;
+}
+
+/*
+ * Make a waiting consumer return even though nothing was put.
+ */
+void ringbuf_wake(ringbuf *rb) {
+	os_event_set(rb->evf_uid, RINGBUF_EVF_WAKE);
+}
 
-	while (size-- > 0) {
-		if (get(c++) == 0) {
-			n_get++;
+/*
+ * Consume size bytes from the front of what ringbuf_peek() returned.
+ */
+int ringbuf_commit(ringbuf *rb, int size) {
+	int n_commit = 0;
+	int done = 0;
+
+	while (done < rb->n_inflight && size > 0) {
+		inflight_rec *rec = &rb->inflight[done];
+		unsigned int n = rec->len - rec->off;
+
+		if (n > (unsigned int)size) {
+			n = size;
+		}
+		rec->off += n;
+		size -= n;
+		n_commit += n;
+
+		if (rec->off < rec->len) {
+			break;
+		}
+		if (rec->r != NULL) {
+			release(rec->r, rec->pos, rec->len);
 		} else {
+			rb->marker_queued = 0;
+		}
+		done++;
+	}
+
+	if (done > 0) {
+		rb->n_inflight -= done;
+		memmove(rb->inflight, rb->inflight + done, rb->n_inflight * sizeof(*rb->inflight));
+
+		// pairs with ringbuf_put_wait(): the tail moved before we look
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&rb->n_waiting, __ATOMIC_RELAXED) != 0) {
+			os_event_set(rb->evf_uid, RINGBUF_EVF_SPACE);
+		}
+	}
+
+	return n_commit;
+}
+
+/*
+ * Hand back what ringbuf_peek() returned and nothing of it was committed,
+ * newest first so the claims left in each ring still start at its tail.
+ * Producers can evict those records again, and the next peek returns
+ * whatever is left of them. A record that went out in part is kept, and
+ * so is everything before it.
+ */
+void ringbuf_unpeek(ringbuf *rb) {
+	while (rb->n_inflight > 0) {
+		inflight_rec *rec = &rb->inflight[rb->n_inflight - 1];
+
+		if (rec->off > 0) {
 			break;
 		}
+		if (rec->r != NULL) {
+			rec->r->n_claimed--;
+			rec->r->cons_pos = rec->pos;
+			store_release(tag(rec->r, rec->pos), rec->pos);
+		} else {
+			// the next marker tells about these together with anything lost meanwhile
+			rb->lost_seen -= rb->marker_lost;
+			rb->lost_bytes_seen -= rb->marker_lost_bytes;
+			rb->marker_queued = 0;
+		}
+		rb->n_inflight--;
 	}
+}
+
+int ringbuf_get(ringbuf *rb, char *c, int size) {
+	ringbuf_span span[2];
+	int n_get = 0;
 
-	if (empty()) {
-		ksceKernelClearEventFlag(evf_uid, ~RINGBUF_EVF_NON_EMPTY);
+	while (n_get < size) {
+		int n_span = ringbuf_peek(rb, span, 2);
+		int n = 0;
+
+		if (n_span == 0) {
+			break;
+		}
+		for (int i = 0; i < n_span && n_get + n < size; i++) {
+			int len = span[i].len;
+			if (len > size - n_get - n) {
+				len = size - n_get - n;
+			}
+			memcpy(c + n_get + n, span[i].ptr, len);
+			n += len;
+		}
+		n_get += ringbuf_commit(rb, n);
 	}
 
-	ksceKernelUnlockMutex(mtx_uid, 1);
-done:
 	return n_get;
 }
+
+int ringbuf_get_wait(ringbuf *rb, char *c, int size, SceUInt *timeout) {
+	ringbuf_span span[2];
+
+	if (ringbuf_peek_wait(rb, span, 2, timeout) == 0) {
+		return 0;
+	}
+	return ringbuf_get(rb, c, size);
+}
+
+void ringbuf_get_stats(ringbuf *rb, ringbuf_stats *stats) {
+	ring_set *set;
+
+	stats->evicted = load_acquire(&rb->totals.evicted);
+	stats->evicted_bytes = load_acquire(&rb->totals.evicted_bytes);
+	stats->dropped = load_acquire(&rb->totals.dropped);
+	stats->dropped_bytes = load_acquire(&rb->totals.dropped_bytes);
+	stats->blocked = load_acquire(&rb->totals.blocked);
+	stats->block_timeouts = load_acquire(&rb->totals.block_timeouts);
+	stats->block_timeout_bytes = load_acquire(&rb->totals.block_timeout_bytes);
+	stats->block_time = load_acquire(&rb->totals.block_time);
+	stats->wakeups = load_acquire(&rb->totals.wakeups);
+
+	stats->size = 0;
+	stats->hwm = 0;
+	stats->time_above_80 = 0;
+	stats->pending = 0;
+
+	// fill telemetry is about the rings in use now
+	set = load_acquire(&rb->cur_set);
+	if (set != NULL) {
+		unsigned int now = (unsigned int)os_time_us();
+
+		stats->size = set->size;
+		for (int i = 0; i < RINGBUF_NCPU; i++) {
+			ring *r = &set->rings[i];
+			SceUInt64 above = r->time_above_80;
+			unsigned int since = load_acquire(&r->above_since);
+
+			if (r->hwm > stats->hwm) {
+				stats->hwm = r->hwm;
+			}
+			// a ring still above 80% has not added its current stretch yet
+			if (since != 0) {
+				above += now - since;
+			}
+			if (above > stats->time_above_80) {
+				stats->time_above_80 = above;
+			}
+			// not cons_pos, that one is the consumer's own
+			stats->pending += load_acquire(&r->head_pos) - load_acquire(&r->tail_pos);
+		}
+	}
+}
@@ -1,14 +1,73 @@
 #ifndef RINGBUF_H
 #define RINGBUF_H
 
-#include <psp2kern/types.h>
+#include "ringbuf_os.h"
 
-int ringbuf_init(int size);
-int ringbuf_term(void);
+// any number of producers, one consumer thread per ringbuf
+typedef struct ringbuf ringbuf;
 
-int ringbuf_put(char *c, int size);
-int ringbuf_put_clobber(char *c, int size);
-int ringbuf_get(char *c, int size);
-int ringbuf_get_wait(char *c, int size, SceUInt *timeout);
+// map each ring twice back to back so no record or span is split by the wrap, if the OS can
+#define RINGBUF_FLAG_MIRRORED 0x00000001
+
+ringbuf *ringbuf_create(int size, unsigned int flags);
+void ringbuf_destroy(ringbuf *rb);
+int ringbuf_resize(ringbuf *rb, int size);
+
+typedef struct ringbuf_span {
+	const char *ptr;
+	unsigned int len;
+} ringbuf_span;
+
+int ringbuf_put(ringbuf *rb, char *c, int size);
+int ringbuf_put_clobber(ringbuf *rb, char *c, int size);
+int ringbuf_put_wait(ringbuf *rb, char *c, int size, SceUInt timeout);
+// one record made of all the src spans
+int ringbuf_putv(ringbuf *rb, const ringbuf_span *src, int n_src);
+int ringbuf_putv_clobber(ringbuf *rb, const ringbuf_span *src, int n_src);
+int ringbuf_putv_wait(ringbuf *rb, const ringbuf_span *src, int n_src, SceUInt timeout);
+// the same stamped with time instead of now, for records put on behalf of someone earlier
+int ringbuf_putv_at(ringbuf *rb, const ringbuf_span *src, int n_src, SceUInt64 time);
+int ringbuf_putv_clobber_at(ringbuf *rb, const ringbuf_span *src, int n_src, SceUInt64 time);
+int ringbuf_putv_wait_at(ringbuf *rb, const ringbuf_span *src, int n_src, SceUInt64 time, SceUInt timeout);
+int ringbuf_get(ringbuf *rb, char *c, int size);
+int ringbuf_get_wait(ringbuf *rb, char *c, int size, SceUInt *timeout);
+
+typedef struct ringbuf_rec {
+	ringbuf_span span[2];	// unsent part, the second span only if it wraps
+	int n_span;
+	unsigned int len;	// unsent bytes
+	SceUInt64 time;		// when it was put
+	int marker;		// the ring's own line about lost records, not put by anyone
+	unsigned int lost;	// records and bytes the marker is about
+	unsigned int lost_bytes;
+} ringbuf_rec;
+
+int ringbuf_wait(ringbuf *rb, SceUInt *timeout);
+int ringbuf_peek(ringbuf *rb, ringbuf_span *span, int n_span);
+int ringbuf_peek_recs(ringbuf *rb, ringbuf_rec *rec, int n_rec);
+int ringbuf_peek_wait(ringbuf *rb, ringbuf_span *span, int n_span, SceUInt *timeout);
+int ringbuf_commit(ringbuf *rb, int size);
+void ringbuf_unpeek(ringbuf *rb);
+void ringbuf_set_wakeup(ringbuf *rb, unsigned int watermark, SceUInt latency);
+void ringbuf_wake(ringbuf *rb);
+
+typedef struct ringbuf_stats {
+	unsigned int evicted;		// oldest records overwritten by clobbering puts
+	unsigned int evicted_bytes;
+	unsigned int dropped;		// new records refused because the ring was full
+	unsigned int dropped_bytes;
+	unsigned int blocked;		// puts that had to wait for space
+	unsigned int block_timeouts;	// waits that gave up, the record was lost
+	unsigned int block_timeout_bytes;
+	SceUInt64 block_time;		// total time (us) puts spent waiting
+	unsigned int wakeups;		// times a put woke the consumer
+
+	unsigned int size;		// current size of each per-CPU ring
+	unsigned int hwm;		// highest fill of any ring since the last resize
+	SceUInt64 time_above_80;	// most time (us) one ring spent above 80% full, a stretch still going on included
+	unsigned int pending;		// bytes put and not committed yet, in the rings in use now
+} ringbuf_stats;
+
+void ringbuf_get_stats(ringbuf *rb, ringbuf_stats *stats);
 
 #endif
@@ -0,0 +1,37 @@
+#ifndef RINGBUF_OS_H
+#define RINGBUF_OS_H
+
+/*
+ * What the ring needs from the OS. ringbuf_os_vita.c implements it for the
+ * kernel module; ringbuf_os_posix.c implements it with pthreads so the ring
+ * can be built and profiled on a Linux host.
+ */
+#ifdef __linux__
+#include <stddef.h>
+#include <stdint.h>
+
+typedef int SceUID;
+typedef unsigned int SceUInt;
+typedef uint64_t SceUInt64;
+#else
+#include <psp2kern/types.h>
+#endif
+
+// event bits; a wait returns once any of the wanted bits is set
+SceUID os_event_create(const char *name);
+void os_event_delete(SceUID ev);
+void os_event_set(SceUID ev, unsigned int bits);
+void os_event_clear(SceUID ev, unsigned int bits);
+// timeout is in us and updated with the time left, NULL waits forever; < 0 on timeout
+int os_event_wait(SceUID ev, unsigned int bits, unsigned int *out_bits, SceUInt *timeout);
+
+// page aligned, *id is passed back to os_mem_free()
+void *os_mem_alloc(const char *name, unsigned int size, SceUID *id);
+// like os_mem_alloc(), but size bytes at base + size are the same pages again; NULL if unsupported
+void *os_mem_alloc_mirrored(const char *name, unsigned int size, SceUID *id);
+void os_mem_free(SceUID id);
+
+SceUInt64 os_time_us(void);
+unsigned int os_cpu_id(void);
+
+#endif
@@ -0,0 +1,250 @@
+/*
+PSVita RE Tools: NetLoggingMgr aka PrincessLog
+Copyright (C) 2020 Asakura Reiko
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+#include "ringbuf_os.h"
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Host backend for building and profiling the ring outside the module.
+ * Event flags are a mutex and condition variable (futex based in glibc),
+ * memory blocks come from posix_memalign(), mirrored ones map a memfd
+ * twice. IDs index small fixed tables, the ring never holds more than a
+ * few of either.
+ */
+#define OS_MAX_EVENTS 8
+#define OS_MAX_MEMBLOCKS 32
+
+typedef struct os_event {
+	int used;
+	unsigned int bits;
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;
+} os_event;
+
+static os_event events[OS_MAX_EVENTS];
+
+typedef struct os_memblock {
+	void *base;
+	size_t map_len;		// 0 if from posix_memalign()
+} os_memblock;
+
+static os_memblock memblocks[OS_MAX_MEMBLOCKS];
+static pthread_mutex_t table_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+SceUID os_event_create(const char *name) {
+	pthread_condattr_t attr;
+	SceUID id = -1;
+
+	(void)name;
+
+	pthread_mutex_lock(&table_mtx);
+	for (int i = 0; i < OS_MAX_EVENTS; i++) {
+		if (!events[i].used) {
+			events[i].used = 1;
+			id = i;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&table_mtx);
+	if (id < 0) {
+		return -1;
+	}
+
+	events[id].bits = 0;
+	pthread_mutex_init(&events[id].mtx, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&events[id].cond, &attr);
+	pthread_condattr_destroy(&attr);
+	return id;
+}
+
+void os_event_delete(SceUID ev) {
+	pthread_cond_destroy(&events[ev].cond);
+	pthread_mutex_destroy(&events[ev].mtx);
+	pthread_mutex_lock(&table_mtx);
+	events[ev].used = 0;
+	pthread_mutex_unlock(&table_mtx);
+}
+
+void os_event_set(SceUID ev, unsigned int bits) {
+	os_event *e = &events[ev];
+
+	pthread_mutex_lock(&e->mtx);
+	e->bits |= bits;
+	pthread_cond_broadcast(&e->cond);
+	pthread_mutex_unlock(&e->mtx);
+}
+
+void os_event_clear(SceUID ev, unsigned int bits) {
+	os_event *e = &events[ev];
+
+	pthread_mutex_lock(&e->mtx);
+	e->bits &= ~bits;
+	pthread_mutex_unlock(&e->mtx);
+}
+
+int os_event_wait(SceUID ev, unsigned int bits, unsigned int *out_bits, SceUInt *timeout) {
+	os_event *e = &events[ev];
+	struct timespec due;
+	SceUInt64 start = 0, elapsed;
+	int ret = 0;
+
+	if (timeout != NULL) {
+		start = os_time_us();
+		clock_gettime(CLOCK_MONOTONIC, &due);
+		due.tv_sec += *timeout / 1000000;
+		due.tv_nsec += (long)(*timeout % 1000000) * 1000;
+		if (due.tv_nsec >= 1000000000) {
+			due.tv_sec++;
+			due.tv_nsec -= 1000000000;
+		}
+	}
+
+	pthread_mutex_lock(&e->mtx);
+	while ((e->bits & bits) == 0) {
+		if (timeout == NULL) {
+			pthread_cond_wait(&e->cond, &e->mtx);
+		} else if (pthread_cond_timedwait(&e->cond, &e->mtx, &due) == ETIMEDOUT) {
+			ret = (e->bits & bits) != 0 ? 0 : -1;
+			break;
+		}
+	}
+	if (out_bits != NULL) {
+		*out_bits = e->bits;
+	}
+	pthread_mutex_unlock(&e->mtx);
+
+	if (timeout != NULL) {
+		elapsed = os_time_us() - start;
+		*timeout = elapsed < *timeout ? *timeout - elapsed : 0;
+	}
+	return ret;
+}
+
+static SceUID memblock_add(void *base, size_t map_len) {
+	SceUID id = -1;
+
+	pthread_mutex_lock(&table_mtx);
+	for (int i = 0; i < OS_MAX_MEMBLOCKS; i++) {
+		if (memblocks[i].base == NULL) {
+			memblocks[i].base = base;
+			memblocks[i].map_len = map_len;
+			id = i;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&table_mtx);
+	return id;
+}
+
+void *os_mem_alloc(const char *name, unsigned int size, SceUID *id) {
+	void *base;
+
+	(void)name;
+
+	*id = -1;
+	if (posix_memalign(&base, 0x1000, (size + 0xFFF) & ~0xFFF) != 0) {
+		return NULL;
+	}
+
+	*id = memblock_add(base, 0);
+	if (*id < 0) {
+		free(base);
+		return NULL;
+	}
+	return base;
+}
+
+void *os_mem_alloc_mirrored(const char *name, unsigned int size, SceUID *id) {
+	size_t len = (size + 0xFFF) & ~0xFFF;
+	char *base;
+	int fd;
+
+	*id = -1;
+	if (len != size) {
+		return NULL;
+	}
+
+	fd = memfd_create(name, MFD_CLOEXEC);
+	if (fd < 0) {
+		return NULL;
+	}
+	if (ftruncate(fd, len) < 0) {
+		goto fail_fd;
+	}
+
+	// reserve both halves first so nothing else can land in between
+	base = mmap(NULL, len * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED) {
+		goto fail_fd;
+	}
+	if (mmap(base, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED
+		|| mmap(base + len, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+		goto fail_map;
+	}
+	close(fd);
+
+	*id = memblock_add(base, len * 2);
+	if (*id < 0) {
+		munmap(base, len * 2);
+		return NULL;
+	}
+	return base;
+
+fail_map:
+	munmap(base, len * 2);
+fail_fd:
+	close(fd);
+	return NULL;
+}
+
+void os_mem_free(SceUID id) {
+	pthread_mutex_lock(&table_mtx);
+	if (memblocks[id].map_len != 0) {
+		munmap(memblocks[id].base, memblocks[id].map_len);
+	} else {
+		free(memblocks[id].base);
+	}
+	memblocks[id].base = NULL;
+	pthread_mutex_unlock(&table_mtx);
+}
+
+SceUInt64 os_time_us(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (SceUInt64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+unsigned int os_cpu_id(void) {
+#ifdef RINGBUF_OS_SINGLE_RING
+	// everyone on the first ring, to compare against the per-CPU split
+	return 0;
+#else
+	int cpu = sched_getcpu();
+
+	return cpu < 0 ? 0 : cpu;
+#endif
+}
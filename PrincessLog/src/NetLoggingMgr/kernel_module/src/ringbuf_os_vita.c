@@ -0,0 +1,93 @@
+/*
+PSVita RE Tools: NetLoggingMgr aka PrincessLog
+Copyright (C) 2020 Asakura Reiko
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "ringbuf_os.h"
+#include <psp2kern/kernel/cpu.h>
+#include <psp2kern/kernel/sysmem.h>
+#include <psp2kern/kernel/threadmgr.h>
+
+#define SCE_KERNEL_ATTR_SINGLE			(0x00000000U)	/**< 複数のスレッドが同時に待機できない(イベントフラグのみ) */
+#define SCE_KERNEL_ATTR_MULTI			(0x00001000U)	/**< 複数のスレッドが同時に待機できる(イベントフラグのみ) */
+#define SCE_KERNEL_ATTR_TH_FIFO			(0x00000000U)	/**< 待機スレッドのキューイングはFIFO */
+#define SCE_KERNEL_ATTR_TH_PRIO			(0x00002000U)	/**< 待機スレッドのキューイングはスレッドの優先度順 */
+
+#define SCE_KERNEL_EVF_ATTR_TH_FIFO		SCE_KERNEL_ATTR_TH_FIFO		/**< イベントフラグの待機スレッドのキューイングはFIFO */
+#define SCE_KERNEL_EVF_ATTR_TH_PRIO		SCE_KERNEL_ATTR_TH_PRIO		/**< イベントフラグの待機スレッドのキューイングはスレッドの優先度順 */
+#define SCE_KERNEL_EVF_ATTR_SINGLE		SCE_KERNEL_ATTR_SINGLE	/**< 複数のスレッドが同時に待機できない */
+#define SCE_KERNEL_EVF_ATTR_MULTI		SCE_KERNEL_ATTR_MULTI	/**< 複数のスレッドが同時に待機できる */
+
+#define SCE_KERNEL_EVF_WAITMODE_AND			(0x00000000U)	/**< AND 待ち */
+#define SCE_KERNEL_EVF_WAITMODE_OR			(0x00000001U)	/**< OR 待ち */
+#define SCE_KERNEL_EVF_WAITMODE_CLEAR_ALL	(0x00000002U)	/**< 待ち成立後、すべてのビットをクリア  */
+#define SCE_KERNEL_EVF_WAITMODE_CLEAR_PAT	(0x00000004U)	/**< 待ち成立後、bitPatternに指定したビットをクリア */
+
+SceUID os_event_create(const char *name) {
+	// producers and the consumer may wait on different bits at once
+	return ksceKernelCreateEventFlag(name,
+		SCE_KERNEL_ATTR_TH_FIFO | SCE_KERNEL_EVF_ATTR_MULTI,
+		0x00000000,
+		NULL);
+}
+
+void os_event_delete(SceUID ev) {
+	ksceKernelDeleteEventFlag(ev);
+}
+
+void os_event_set(SceUID ev, unsigned int bits) {
+	ksceKernelSetEventFlag(ev, bits);
+}
+
+void os_event_clear(SceUID ev, unsigned int bits) {
+	// the flag is ANDed with the pattern
+	ksceKernelClearEventFlag(ev, ~bits);
+}
+
+int os_event_wait(SceUID ev, unsigned int bits, unsigned int *out_bits, SceUInt *timeout) {
+	return ksceKernelWaitEventFlag(ev, bits, SCE_KERNEL_EVF_WAITMODE_OR, out_bits, timeout);
+}
+
+void *os_mem_alloc(const char *name, unsigned int size, SceUID *id) {
+	void *base = NULL;
+
+	*id = ksceKernelAllocMemBlock(name, 0x6020D006, (size + 0xFFF) & ~0xFFF, NULL);
+	if (*id < 0) {
+		return NULL;
+	}
+	ksceKernelGetMemBlockBase(*id, &base);
+	return base;
+}
+
+/*
+ * SceSysmem offers no documented way to map one memblock twice in a row,
+ * so rings here always use the plain layout.
+ */
+void *os_mem_alloc_mirrored(const char *name, unsigned int size, SceUID *id) {
+	*id = -1;
+	return NULL;
+}
+
+void os_mem_free(SceUID id) {
+	ksceKernelFreeMemBlock(id);
+}
+
+SceUInt64 os_time_us(void) {
+	return ksceKernelGetSystemTimeWide();
+}
+
+unsigned int os_cpu_id(void) {
+	return ksceKernelCpuGetCpuId();
+}
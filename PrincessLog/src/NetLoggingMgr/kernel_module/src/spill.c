@@ -0,0 +1,240 @@
+/*
+PSVita RE Tools: NetLoggingMgr aka PrincessLog
+Copyright (C) 2020 Asakura Reiko
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "spill.h"
+#include "spill_os.h"
+
+/*
+ * While the server is unreachable net_thread moves ring data here instead
+ * of letting it be overwritten. Data is gathered in buf and appended to
+ * path_cur in large writes. Once path_cur reaches SPILL_FILE_MAX it
+ * becomes path_old, replacing the previous one, so storage use stays
+ * bounded and only the oldest spilled data is lost. Both live in the
+ * directory given to spill_init(), file access is behind spill_os.h.
+ *
+ * After reconnecting the files are replayed oldest first, ahead of the
+ * ring, through spill_peek()/spill_commit(). replay_off is how far the
+ * oldest file was sent. Only net_thread calls in here.
+ */
+#define SPILL_PATH_LEN 64
+
+#define SPILL_FILE_MAX 0x100000
+#define SPILL_BUF_LEN 0x4000
+
+void *memcpy(void *dst, const void *src, size_t n);
+void *memset(void *dst, int ch, size_t n);
+int snprintf(char *s, size_t n, const char *fmt, ...);
+
+// buf holds either spilled data not written yet, or a chunk being replayed
+#define SPILL_BUF_WRITE 0
+#define SPILL_BUF_READ 1
+
+static char buf[SPILL_BUF_LEN];
+static int buf_mode = SPILL_BUF_WRITE;
+static unsigned int buf_len = 0;
+static unsigned int buf_off = 0;	// replayed part of a read chunk
+
+static int has_old = 0, has_cur = 0;
+static unsigned int old_size = 0, cur_size = 0;
+static unsigned int replay_off = 0;
+
+static char path_cur[SPILL_PATH_LEN];
+static char path_old[SPILL_PATH_LEN];
+
+static spill_stats stats;
+
+static void rotate(void) {
+	if (has_old) {
+		os_file_remove(path_old);
+		// only the unsent part was still wanted
+		stats.lost_bytes += old_size - replay_off;
+		replay_off = 0;
+	}
+	if (os_file_rename(path_cur, path_old) < 0) {
+		stats.errors++;
+		stats.lost_bytes += cur_size - replay_off;
+		os_file_remove(path_cur);
+		has_old = 0;
+		old_size = 0;
+		replay_off = 0;
+	} else {
+		has_old = 1;
+		old_size = cur_size;
+	}
+	has_cur = 0;
+	cur_size = 0;
+}
+
+// write out what spill_write() gathered
+int spill_flush(void) {
+	int ret;
+
+	if (buf_mode != SPILL_BUF_WRITE || buf_len == 0) {
+		return 0;
+	}
+
+	ret = os_file_append(path_cur, buf, buf_len);
+	if (ret < 0) {
+		stats.errors++;
+		return ret;
+	}
+	has_cur = 1;
+	cur_size += ret;
+	stats.spilled_bytes += ret;
+	buf_len = 0;
+
+	if (cur_size >= SPILL_FILE_MAX) {
+		rotate();
+	}
+	return 0;
+}
+
+/*
+ * Take over the spans from the ring. Returns the number of bytes taken,
+ * which the caller commits, or < 0 if storage failed and nothing was.
+ */
+int spill_write(const ringbuf_span *span, int n_span) {
+	int total = 0;
+	int ret;
+
+	if (buf_mode == SPILL_BUF_READ) {
+		// a replay was cut short, it restarts from replay_off later
+		buf_mode = SPILL_BUF_WRITE;
+		buf_len = 0;
+		buf_off = 0;
+	}
+
+	for (int i = 0; i < n_span; i++) {
+		const char *ptr = span[i].ptr;
+		unsigned int len = span[i].len;
+
+		while (len > 0) {
+			unsigned int n = SPILL_BUF_LEN - buf_len;
+
+			if (n == 0) {
+				ret = spill_flush();
+				if (ret < 0) {
+					return total ? total : ret;
+				}
+				continue;
+			}
+			if (n > len) {
+				n = len;
+			}
+			memcpy(buf + buf_len, ptr, n);
+			buf_len += n;
+			ptr += n;
+			len -= n;
+			total += n;
+		}
+	}
+
+	return total;
+}
+
+int spill_pending(void) {
+	return has_old || has_cur || (buf_mode == SPILL_BUF_WRITE && buf_len > 0);
+}
+
+/*
+ * Next chunk of spilled data to send, oldest first. Returns its length,
+ * or 0 once everything was replayed.
+ */
+int spill_peek(const char **ptr) {
+	int ret;
+
+	if (spill_flush() < 0) {
+		// it cannot go anywhere, and would keep the replay from ever ending
+		stats.lost_bytes += buf_len;
+		buf_len = 0;
+	}
+
+	if (buf_mode == SPILL_BUF_READ && buf_off < buf_len) {
+		*ptr = buf + buf_off;
+		return buf_len - buf_off;
+	}
+	buf_mode = SPILL_BUF_READ;
+	buf_len = 0;
+	buf_off = 0;
+
+	while (has_old || has_cur) {
+		const char *path = has_old ? path_old : path_cur;
+
+		ret = os_file_read_at(path, replay_off, buf, SPILL_BUF_LEN);
+		if (ret > 0) {
+			buf_len = ret;
+			*ptr = buf;
+			return ret;
+		}
+		if (ret < 0) {
+			// an unreadable file would block the replay forever
+			stats.errors++;
+		}
+
+		os_file_remove(path);
+		if (has_old) {
+			has_old = 0;
+			old_size = 0;
+		} else {
+			has_cur = 0;
+			cur_size = 0;
+		}
+		replay_off = 0;
+	}
+
+	return 0;
+}
+
+// size bytes of the last spill_peek() chunk were sent
+void spill_commit(int size) {
+	buf_off += size;
+	replay_off += size;
+	stats.replayed_bytes += size;
+}
+
+/*
+ * Spill into dir. Files left over there from before a reboot are picked
+ * up and replayed first.
+ */
+int spill_init(const char *dir) {
+	int size;
+
+	if (snprintf(path_cur, sizeof(path_cur), "%s/NetLoggingMgrSpill.bin", dir) >= (int)sizeof(path_cur)
+		|| snprintf(path_old, sizeof(path_old), "%s/NetLoggingMgrSpill.old", dir) >= (int)sizeof(path_old)) {
+		return -1;
+	}
+
+	memset(&stats, 0, sizeof(stats));
+	buf_mode = SPILL_BUF_WRITE;
+	buf_len = 0;
+	buf_off = 0;
+	replay_off = 0;
+
+	size = os_file_size(path_old);
+	has_old = size >= 0;
+	old_size = has_old ? size : 0;
+
+	size = os_file_size(path_cur);
+	has_cur = size >= 0;
+	cur_size = has_cur ? size : 0;
+
+	return 0;
+}
+
+void spill_get_stats(spill_stats *out) {
+	*out = stats;
+}
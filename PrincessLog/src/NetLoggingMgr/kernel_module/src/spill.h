@@ -0,0 +1,24 @@
+#ifndef SPILL_H
+#define SPILL_H
+
+#include "ringbuf.h"
+
+int spill_init(const char *dir);
+
+int spill_write(const ringbuf_span *span, int n_span);
+int spill_flush(void);
+
+int spill_pending(void);
+int spill_peek(const char **ptr);
+void spill_commit(int size);
+
+typedef struct spill_stats {
+	unsigned int spilled_bytes;	// written to storage while the server was down
+	unsigned int replayed_bytes;	// sent from storage after reconnecting
+	unsigned int lost_bytes;	// removed by rotation before they were replayed
+	unsigned int errors;		// failed file accesses
+} spill_stats;
+
+void spill_get_stats(spill_stats *stats);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef SPILL_OS_H
+#define SPILL_OS_H
+
+/*
+ * What spilling needs from the OS. spill_os_vita.c implements it with the
+ * kernel I/O calls, spill_os_posix.c with POSIX files so the spill and
+ * replay logic can be tested on a Linux host. All return < 0 on error.
+ */
+
+int os_file_size(const char *path);
+// open, append, close; returns the bytes written
+int os_file_append(const char *path, const void *data, unsigned int len);
+// returns the bytes read, 0 at the end of the file
+int os_file_read_at(const char *path, unsigned int off, void *data, unsigned int len);
+int os_file_remove(const char *path);
+int os_file_rename(const char *from, const char *to);
+
+#endif
@@ -0,0 +1,62 @@
+/*
+PSVita RE Tools: NetLoggingMgr aka PrincessLog
+Copyright (C) 2020 Asakura Reiko
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "spill_os.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// host backend for testing the spill logic, errors are just -1
+
+int os_file_size(const char *path) {
+	struct stat st;
+
+	return stat(path, &st) < 0 ? -1 : (int)st.st_size;
+}
+
+int os_file_append(const char *path, const void *data, unsigned int len) {
+	int fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0666);
+	int ret;
+
+	if (fd < 0) {
+		return -1;
+	}
+	ret = write(fd, data, len);
+	close(fd);
+	return ret;
+}
+
+int os_file_read_at(const char *path, unsigned int off, void *data, unsigned int len) {
+	int fd = open(path, O_RDONLY);
+	int ret;
+
+	if (fd < 0) {
+		return -1;
+	}
+	ret = pread(fd, data, len, off);
+	close(fd);
+	return ret;
+}
+
+int os_file_remove(const char *path) {
+	return unlink(path);
+}
+
+int os_file_rename(const char *from, const char *to) {
+	return rename(from, to);
+}
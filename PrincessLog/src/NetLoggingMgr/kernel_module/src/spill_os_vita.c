@@ -0,0 +1,62 @@
+/*
+PSVita RE Tools: NetLoggingMgr aka PrincessLog
+Copyright (C) 2020 Asakura Reiko
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "spill_os.h"
+#include <psp2kern/io/fcntl.h>
+#include <psp2kern/io/stat.h>
+
+int os_file_size(const char *path) {
+	SceIoStat stat;
+	int ret = ksceIoGetstat(path, &stat);
+
+	return ret < 0 ? ret : (int)stat.st_size;
+}
+
+int os_file_append(const char *path, const void *data, unsigned int len) {
+	SceUID fd = ksceIoOpen(path, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_APPEND, 0666);
+	int ret;
+
+	if (fd < 0) {
+		return fd;
+	}
+	ret = ksceIoWrite(fd, data, len);
+	ksceIoClose(fd);
+	return ret;
+}
+
+int os_file_read_at(const char *path, unsigned int off, void *data, unsigned int len) {
+	SceUID fd = ksceIoOpen(path, SCE_O_RDONLY, 0);
+	int ret;
+
+	if (fd < 0) {
+		return fd;
+	}
+	ret = ksceIoLseek(fd, off, SCE_SEEK_SET);
+	if (ret >= 0) {
+		ret = ksceIoRead(fd, data, len);
+	}
+	ksceIoClose(fd);
+	return ret;
+}
+
+int os_file_remove(const char *path) {
+	return ksceIoRemove(path);
+}
+
+int os_file_rename(const char *from, const char *to) {
+	return ksceIoRename(from, to);
+}
@@ -225,6 +225,173 @@ end:
 	return res;
 }
 
+int SetRingSize(void){
+
+	int res;
+	uint32_t ring_size;
+	char RingSizeStrUtf8[6];
+	uint16_t RingSizeStr[6];
+
+	SceImeDialogParam param;
+	sceClibMemset(&param, 0, sizeof(param));
+	sceImeDialogParamInit(&param);
+
+	param.title = u"Enter Ring Size per CPU in KiB (0:default)";
+	param.maxTextLength = (sizeof(RingSizeStr)/2)-1;
+	param.initialText = u"";
+	param.inputTextBuffer = RingSizeStr;
+	param.type = SCE_IME_TYPE_NUMBER;
+	res = CallImeDialog(&param);
+	utf16_to_utf8((const uint16_t *)&RingSizeStr, (uint8_t *)&RingSizeStrUtf8);
+
+	psvDebugScreenClear(COLOR_DEFAULT_BG);
+	psvDebugScreenSet();
+
+	if(res < 0){
+		psvDebugScreenPrintf("Error : CallImeDialog failed: %x\n", res);
+		goto end;
+	}
+
+	ring_size = atoi(RingSizeStrUtf8) * 0x400;
+
+	if(ring_size != 0 && (ring_size < MIN_RING_SIZE || ring_size > MAX_RING_SIZE)){
+		psvDebugScreenPrintf("Error : Ring Size must be %d to %d KiB.\n", MIN_RING_SIZE / 0x400, MAX_RING_SIZE / 0x400);
+		goto end;
+	}
+
+	NetLoggingMgrConfig.ring_size = ring_size;
+
+	psvDebugScreenPrintf("Set Ring Size : Success.\n");
+
+end:
+
+	psvDebugScreenPrintf("\n");
+	psvDebugScreenPrintf("please key press\n");
+
+	ReadPad();
+	WaitKeyPress();
+	ReadPad();
+	swap_fb();
+
+	return res;
+}
+
+int RingStats(void){
+
+	int search_unk[2];
+	SceUID res;
+	NetLoggingMgrStats_t stats;
+
+	psvDebugScreenSet();
+
+	res = _vshKernelSearchModuleByName("NetLoggingMgr", search_unk);
+	if(res < 0){
+
+		psvDebugScreenPrintf("Error : NetLoggingMgr not loaded\n");
+		goto end;
+
+	}
+
+	res = NetLoggingMgrGetStats(&stats);
+	if(res < 0){
+
+		psvDebugScreenPrintf("Get Stats Error : 0x%X\n", res);
+		goto end;
+
+	}
+
+	psvDebugScreenPrintf("Ring Size     : 0x%X\n", stats.ring_size);
+	psvDebugScreenPrintf("High Water    : 0x%X (%d%%)\n", stats.hwm, stats.ring_size ? stats.hwm * 100 / stats.ring_size : 0);
+	psvDebugScreenPrintf("Above 80%%     : %llu ms\n", stats.time_above_80 / 1000);
+	psvDebugScreenPrintf("Evicted       : %u (%u bytes)\n", stats.evicted, stats.evicted_bytes);
+	psvDebugScreenPrintf("Dropped       : %u (%u bytes)\n", stats.dropped, stats.dropped_bytes);
+	psvDebugScreenPrintf("Blocked       : %u (%llu ms)\n", stats.blocked, stats.block_time / 1000);
+	psvDebugScreenPrintf("Block Timeout : %u (%u bytes)\n", stats.block_timeouts, stats.block_timeout_bytes);
+	psvDebugScreenPrintf("Wakeups       : %u\n", stats.wakeups);
+	psvDebugScreenPrintf("Spilled       : %u bytes\n", stats.spilled_bytes);
+	psvDebugScreenPrintf("Replayed      : %u bytes\n", stats.replayed_bytes);
+	psvDebugScreenPrintf("Spill Lost    : %u bytes (%u errors)\n", stats.spill_lost_bytes, stats.spill_errors);
+	psvDebugScreenPrintf("Connects      : %u (%u failed, %u lost)\n", stats.connects, stats.connect_failures, stats.disconnects);
+	psvDebugScreenPrintf("Connect Time  : %u ms last, %u ms max, %llu ms avg\n", stats.connect_time_last / 1000, stats.connect_time_max / 1000, stats.connects ? stats.connect_time_total / stats.connects / 1000 : 0);
+	psvDebugScreenPrintf("Compressed    : %u blocks (%u sent as is), %llu -> %llu bytes\n", stats.lz_blocks, stats.lz_fallbacks, stats.lz_in_bytes, stats.lz_out_bytes);
+	psvDebugScreenPrintf("Compress Rate : %llu KB/s\n", stats.lz_time ? stats.lz_in_bytes * 1000 / stats.lz_time : 0);
+	psvDebugScreenPrintf("Sends         : %u (%llu bytes, %llu avg)\n", stats.sends, stats.send_bytes, stats.sends ? stats.send_bytes / stats.sends : 0);
+	psvDebugScreenPrintf("Batches       : %u (%llu records avg)\n", stats.batches, stats.batches ? stats.batch_recs / stats.batches : 0);
+	psvDebugScreenPrintf("Filtered      : %u (%u modules loaded)\n", stats.filtered, stats.filter_modules);
+
+	for(int i = 0; i < NLM_DEST_MAX; i++){
+		const NetLoggingMgrDestStats_t *dest = &stats.dest[i];
+
+		if(i > 0 && NetLoggingMgrConfig.dest[i - 1].IPv4 == 0 && dest->send_bytes == 0){
+			continue;
+		}
+		psvDebugScreenPrintf(i == 0 ? "Server        : " : "Destination %d : ", i);
+		psvDebugScreenPrintf("%s, %u bytes %llu ms behind, %u evicted, %llu sent\n",
+			dest->up ? "up" : "down", dest->pending_bytes, dest->lag / 1000, dest->evicted, dest->send_bytes);
+	}
+
+end:
+
+	psvDebugScreenPrintf("\n");
+	psvDebugScreenPrintf("please key press\n");
+
+	WaitKeyPress();
+	ReadPad();
+	swap_fb();
+
+	return 0;
+}
+
+
+int DumpRecent(void){
+
+	static char recent[NLM_RECENT_SIZE];
+	int search_unk[2];
+	SceUID res, fd;
+
+	psvDebugScreenSet();
+
+	res = _vshKernelSearchModuleByName("NetLoggingMgr", search_unk);
+	if(res < 0){
+
+		psvDebugScreenPrintf("Error : NetLoggingMgr not loaded\n");
+		goto end;
+
+	}
+
+	res = NetLoggingMgrDumpRecent(recent, sizeof(recent));
+	if(res < 0){
+
+		psvDebugScreenPrintf("Dump Recent Error : 0x%X\n", res);
+		goto end;
+
+	}
+
+	fd = sceIoOpen("ux0:data/NetLoggingMgrRecent.txt", SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0666);
+	if(fd < 0){
+
+		psvDebugScreenPrintf("Open Error : 0x%X\n", fd);
+		goto end;
+
+	}
+
+	sceIoWrite(fd, recent, res);
+	sceIoClose(fd);
+
+	psvDebugScreenPrintf("Saved %d bytes to ux0:data/NetLoggingMgrRecent.txt\n", res);
+
+end:
+
+	psvDebugScreenPrintf("\n");
+	psvDebugScreenPrintf("please key press\n");
+
+	WaitKeyPress();
+	ReadPad();
+	swap_fb();
+
+	return 0;
+}
+
 
 typedef struct MenuItem_t{
 	int text_x;
@@ -555,6 +722,518 @@ int QafSettings(void){
 	return 0;
 }
 
+const char *policy_name[NLM_POLICY_MAX] = {
+	"Overwrite oldest",
+	"Drop newest",
+	"Block with timeout"
+};
+
+const char *PolicyName(uint8_t policy){
+	return (policy < NLM_POLICY_MAX) ? policy_name[policy] : "Unknown";
+}
+
+int BackpressureSettings(void){
+
+	int sel = 0;
+	int sel_max = 4;
+
+	while(1){
+
+		psvDebugScreenPrintf2(0,  20 + (10 * sel),  "*");
+
+		psvDebugScreenPrintf2(0,   0,  "-- Backpressure Setting --");
+
+		psvDebugScreenPrintf2(20, 20,  "kernel printf : %s", PolicyName(NetLoggingMgrConfig.policy[NLM_SOURCE_KERNEL_PRINTF]));
+		psvDebugScreenPrintf2(20, 30,  "user printf   : %s", PolicyName(NetLoggingMgrConfig.policy[NLM_SOURCE_USER_PUTCHAR]));
+		psvDebugScreenPrintf2(20, 40,  "spill to storage : %s", (NetLoggingMgrConfig.flags & NLM_CONFIG_FLAGS_BIT_SPILL) ? "Enable" : "Disable");
+		psvDebugScreenPrintf2(20, 50,  "Back");
+
+		psvDebugScreenSet();
+		swap_fb();
+		psvDebugScreenClear(COLOR_DEFAULT_BG);
+
+		WaitKeyPress();
+
+		if(press_padd & SCE_CTRL_UP){
+			if(sel == 0){
+				sel = sel_max - 1;
+			}else{
+				sel--;
+			}
+		}
+
+		if(press_padd & SCE_CTRL_DOWN){
+			if(sel == (sel_max-1)){
+				sel = 0;
+			}else{
+				sel++;
+			}
+		}
+
+		if(press_padd & SCE_CTRL_CIRCLE){
+			if(sel == (sel_max-1)){
+				break;
+			}else if(sel == 2){
+
+				NetLoggingMgrConfig.flags ^= NLM_CONFIG_FLAGS_BIT_SPILL;
+
+			}else{
+
+				uint8_t *policy = &NetLoggingMgrConfig.policy[(sel == 0) ? NLM_SOURCE_KERNEL_PRINTF : NLM_SOURCE_USER_PUTCHAR];
+
+				*policy = (*policy + 1) % NLM_POLICY_MAX;
+
+			}
+		}
+
+	}
+
+	ReadPad();
+
+	return 0;
+}
+
+int LogFormatSettings(void){
+
+	int sel = 0;
+	int sel_max = 4;
+
+	while(1){
+
+		psvDebugScreenPrintf2(0,  20 + (10 * sel),  "*");
+
+		psvDebugScreenPrintf2(0,   0,  "-- Log Format Setting --");
+
+		psvDebugScreenPrintf2(20, 20,  "deferred kernel printf : %s", (NetLoggingMgrConfig.flags & NLM_CONFIG_FLAGS_BIT_DEFERRED_FORMAT) ? "Enable" : "Disable");
+		psvDebugScreenPrintf2(20, 30,  "binary wire protocol   : %s", (NetLoggingMgrConfig.flags & NLM_CONFIG_FLAGS_BIT_BINARY_WIRE) ? "Enable" : "Disable");
+		psvDebugScreenPrintf2(20, 40,  "compress binary TCP    : %s", (NetLoggingMgrConfig.flags & NLM_CONFIG_FLAGS_BIT_COMPRESS) ? "Enable" : "Disable");
+		psvDebugScreenPrintf2(20, 50,  "Back");
+
+		psvDebugScreenSet();
+		swap_fb();
+		psvDebugScreenClear(COLOR_DEFAULT_BG);
+
+		WaitKeyPress();
+
+		if(press_padd & SCE_CTRL_UP){
+			if(sel == 0){
+				sel = sel_max - 1;
+			}else{
+				sel--;
+			}
+		}
+
+		if(press_padd & SCE_CTRL_DOWN){
+			if(sel == (sel_max-1)){
+				sel = 0;
+			}else{
+				sel++;
+			}
+		}
+
+		if(press_padd & SCE_CTRL_CIRCLE){
+			if(sel == 0){
+
+				NetLoggingMgrConfig.flags ^= NLM_CONFIG_FLAGS_BIT_DEFERRED_FORMAT;
+
+			}else if(sel == 1){
+
+				NetLoggingMgrConfig.flags ^= NLM_CONFIG_FLAGS_BIT_BINARY_WIRE;
+
+			}else if(sel == 2){
+
+				NetLoggingMgrConfig.flags ^= NLM_CONFIG_FLAGS_BIT_COMPRESS;
+
+			}else if(sel == (sel_max-1)){
+				break;
+			}
+		}
+
+	}
+
+	ReadPad();
+
+	return 0;
+}
+
+// 0 is the default, the rest are steps to cycle through
+const uint32_t batch_size_step[] = {0, 2920, 5840, MAX_BATCH_SIZE};
+const uint32_t wake_latency_step[] = {0, 1000, 20 * 1000, 100 * 1000};
+
+uint32_t NextStep(const uint32_t *step, int n, uint32_t value){
+	for(int i = 0; i < n - 1; i++){
+		if(step[i] == value){
+			return step[i + 1];
+		}
+	}
+	return step[0];
+}
+
+int TransportSettings(void){
+
+	int sel = 0;
+	int sel_max = 5;
+
+	while(1){
+
+		psvDebugScreenPrintf2(0,  20 + (10 * sel),  "*");
+
+		psvDebugScreenPrintf2(0,   0,  "-- Transport Setting --");
+
+		psvDebugScreenPrintf2(20, 20,  "transport      : %s", (NetLoggingMgrConfig.flags & NLM_CONFIG_FLAGS_BIT_UDP) ? "UDP datagrams" : "TCP");
+		psvDebugScreenPrintf2(20, 30,  "TCP_NODELAY    : %s", (NetLoggingMgrConfig.flags & NLM_CONFIG_FLAGS_BIT_TCP_NODELAY) ? "Enable" : "Disable");
+		psvDebugScreenPrintf2(20, 40,  "batch size     : %u bytes", NetLoggingMgrConfig.batch_size ? NetLoggingMgrConfig.batch_size : DEFAULT_BATCH_SIZE);
+		psvDebugScreenPrintf2(20, 50,  "flush deadline : %u us", NetLoggingMgrConfig.wake_latency ? NetLoggingMgrConfig.wake_latency : DEFAULT_WAKE_LATENCY);
+		psvDebugScreenPrintf2(20, 60,  "Back");
+
+		psvDebugScreenSet();
+		swap_fb();
+		psvDebugScreenClear(COLOR_DEFAULT_BG);
+
+		WaitKeyPress();
+
+		if(press_padd & SCE_CTRL_UP){
+			if(sel == 0){
+				sel = sel_max - 1;
+			}else{
+				sel--;
+			}
+		}
+
+		if(press_padd & SCE_CTRL_DOWN){
+			if(sel == (sel_max-1)){
+				sel = 0;
+			}else{
+				sel++;
+			}
+		}
+
+		if(press_padd & SCE_CTRL_CIRCLE){
+			if(sel == 0){
+
+				NetLoggingMgrConfig.flags ^= NLM_CONFIG_FLAGS_BIT_UDP;
+
+			}else if(sel == 1){
+
+				NetLoggingMgrConfig.flags ^= NLM_CONFIG_FLAGS_BIT_TCP_NODELAY;
+
+			}else if(sel == 2){
+
+				NetLoggingMgrConfig.batch_size = NextStep(batch_size_step, sizeof(batch_size_step) / sizeof(batch_size_step[0]), NetLoggingMgrConfig.batch_size);
+
+			}else if(sel == 3){
+
+				NetLoggingMgrConfig.wake_latency = NextStep(wake_latency_step, sizeof(wake_latency_step) / sizeof(wake_latency_step[0]), NetLoggingMgrConfig.wake_latency);
+
+			}else if(sel == (sel_max-1)){
+				break;
+			}
+		}
+
+	}
+
+	ReadPad();
+
+	return 0;
+}
+
+int SetDestination(NetLoggingMgrDest_t *dest){
+
+	int res;
+	uint32_t IPv4;
+	char IPv4StrUtf8[16], PortStrUtf8[6];
+	uint16_t IPv4Str[16], PortStr[6];
+
+	SceImeDialogParam param;
+	sceClibMemset(&param, 0, sizeof(param));
+	sceImeDialogParamInit(&param);
+
+	param.title = u"Enter Destination IPv4 (empty:unused)";
+	param.maxTextLength = (sizeof(IPv4Str)/2)-1;
+	param.initialText = u"";
+	param.inputTextBuffer = IPv4Str;
+	param.type = SCE_IME_TYPE_EXTENDED_NUMBER;
+	res = CallImeDialog(&param);
+	utf16_to_utf8((const uint16_t *)&IPv4Str, (uint8_t *)&IPv4StrUtf8);
+
+	psvDebugScreenClear(COLOR_DEFAULT_BG);
+	psvDebugScreenSet();
+
+	if(res < 0){
+		psvDebugScreenPrintf("Error : CallImeDialog failed: %x\n", res);
+		goto end;
+	}
+
+	if(IPv4StrUtf8[0] == '\0'){
+		sceClibMemset(dest, 0, sizeof(*dest));
+		psvDebugScreenPrintf("Clear Destination : Success.\n");
+		goto end;
+	}
+
+	res = sceNetInetPton(SCE_NET_AF_INET, IPv4StrUtf8, &IPv4);
+	if(res != 1){
+		psvDebugScreenPrintf("Error : Invalid IPv4.\n");
+		goto end;
+	}
+
+	sceClibMemset(&param, 0, sizeof(param));
+	sceImeDialogParamInit(&param);
+
+	param.title = u"Enter Destination Port (0:default)";
+	param.maxTextLength = (sizeof(PortStr)/2)-1;
+	param.initialText = u"";
+	param.inputTextBuffer = PortStr;
+	param.type = SCE_IME_TYPE_NUMBER;
+	res = CallImeDialog(&param);
+	utf16_to_utf8((const uint16_t *)&PortStr, (uint8_t *)&PortStrUtf8);
+
+	psvDebugScreenClear(COLOR_DEFAULT_BG);
+	psvDebugScreenSet();
+
+	if(res < 0){
+		psvDebugScreenPrintf("Error : CallImeDialog failed: %x\n", res);
+		goto end;
+	}
+
+	if(atoi(PortStrUtf8) < 0 || atoi(PortStrUtf8) > UINT16_MAX){
+		psvDebugScreenPrintf("Error : Invalid Port.\n");
+		goto end;
+	}
+
+	dest->IPv4 = IPv4;
+	dest->port = atoi(PortStrUtf8);
+
+	psvDebugScreenPrintf("Set Destination : Success.\n");
+
+end:
+
+	psvDebugScreenPrintf("\n");
+	psvDebugScreenPrintf("please key press\n");
+
+	ReadPad();
+	WaitKeyPress();
+	ReadPad();
+	swap_fb();
+
+	return res;
+}
+
+// every destination gets all records, each at its own pace
+int DestinationSettings(void){
+
+	int sel = 0;
+	int sel_max = NLM_DEST_MAX;
+
+	while(1){
+
+		psvDebugScreenPrintf2(0,  20 + (10 * sel),  "*");
+
+		psvDebugScreenPrintf2(0,   0,  "-- Destination Setting --");
+
+		for(int i = 0; i < NLM_DEST_MAX - 1; i++){
+			const NetLoggingMgrDest_t *dest = &NetLoggingMgrConfig.dest[i];
+			const uint8_t *ip = (const uint8_t *)&dest->IPv4;
+
+			if(dest->IPv4 == 0){
+				psvDebugScreenPrintf2(20, 20 + (10 * i),  "destination %d  : unused", i + 1);
+			}else{
+				psvDebugScreenPrintf2(20, 20 + (10 * i),  "destination %d  : %d.%d.%d.%d:%d", i + 1, ip[0], ip[1], ip[2], ip[3], dest->port ? dest->port : DEFAULT_PORT);
+			}
+		}
+		psvDebugScreenPrintf2(20, 20 + (10 * (sel_max - 1)),  "Back");
+
+		psvDebugScreenSet();
+		swap_fb();
+		psvDebugScreenClear(COLOR_DEFAULT_BG);
+
+		WaitKeyPress();
+
+		if(press_padd & SCE_CTRL_UP){
+			if(sel == 0){
+				sel = sel_max - 1;
+			}else{
+				sel--;
+			}
+		}
+
+		if(press_padd & SCE_CTRL_DOWN){
+			if(sel == (sel_max-1)){
+				sel = 0;
+			}else{
+				sel++;
+			}
+		}
+
+		if(press_padd & SCE_CTRL_CIRCLE){
+			if(sel == (sel_max-1)){
+				break;
+			}
+
+			SetDestination(&NetLoggingMgrConfig.dest[sel]);
+		}
+
+	}
+
+	ReadPad();
+
+	return 0;
+}
+
+int SetFilterModule(char *module){
+
+	int res;
+	char ModuleStrUtf8[NLM_FILTER_NAME_LEN * 3];
+	uint16_t ModuleStr[NLM_FILTER_NAME_LEN];
+
+	SceImeDialogParam param;
+	sceClibMemset(&param, 0, sizeof(param));
+	sceImeDialogParamInit(&param);
+
+	param.title = u"Enter Kernel Module Name to Mute (empty:unused)";
+	param.maxTextLength = (sizeof(ModuleStr)/2)-1;
+	param.initialText = u"";
+	param.inputTextBuffer = ModuleStr;
+	param.type = SCE_IME_TYPE_BASIC_LATIN;
+	res = CallImeDialog(&param);
+	utf16_to_utf8((const uint16_t *)&ModuleStr, (uint8_t *)&ModuleStrUtf8);
+
+	psvDebugScreenClear(COLOR_DEFAULT_BG);
+	psvDebugScreenSet();
+
+	if(res < 0){
+		psvDebugScreenPrintf("Error : CallImeDialog failed: %x\n", res);
+		goto end;
+	}
+
+	sceClibMemset(module, 0, NLM_FILTER_NAME_LEN);
+	strncpy(module, ModuleStrUtf8, NLM_FILTER_NAME_LEN - 1);
+
+	psvDebugScreenPrintf("Set Filter Module : Success.\n");
+
+end:
+
+	psvDebugScreenPrintf("\n");
+	psvDebugScreenPrintf("please key press\n");
+
+	ReadPad();
+	WaitKeyPress();
+	ReadPad();
+	swap_fb();
+
+	return res;
+}
+
+int SetFilterPid(uint32_t *pid){
+
+	int res;
+	char PidStrUtf8[12];
+	uint16_t PidStr[12];
+
+	SceImeDialogParam param;
+	sceClibMemset(&param, 0, sizeof(param));
+	sceImeDialogParamInit(&param);
+
+	param.title = u"Enter Process ID to Mute in hex (empty:unused)";
+	param.maxTextLength = (sizeof(PidStr)/2)-1;
+	param.initialText = u"";
+	param.inputTextBuffer = PidStr;
+	param.type = SCE_IME_TYPE_BASIC_LATIN;
+	res = CallImeDialog(&param);
+	utf16_to_utf8((const uint16_t *)&PidStr, (uint8_t *)&PidStrUtf8);
+
+	psvDebugScreenClear(COLOR_DEFAULT_BG);
+	psvDebugScreenSet();
+
+	if(res < 0){
+		psvDebugScreenPrintf("Error : CallImeDialog failed: %x\n", res);
+		goto end;
+	}
+
+	*pid = strtoul(PidStrUtf8, NULL, 16);
+
+	psvDebugScreenPrintf("Set Filter Process ID : Success.\n");
+
+end:
+
+	psvDebugScreenPrintf("\n");
+	psvDebugScreenPrintf("please key press\n");
+
+	ReadPad();
+	WaitKeyPress();
+	ReadPad();
+	swap_fb();
+
+	return res;
+}
+
+// muted output is dropped before the module formats it
+int FilterSettings(void){
+
+	int sel = 0;
+	int sel_max = NLM_FILTER_MODULE_MAX + NLM_FILTER_PID_MAX + 1;
+
+	while(1){
+
+		psvDebugScreenPrintf2(0,  20 + (10 * sel),  "*");
+
+		psvDebugScreenPrintf2(0,   0,  "-- Filter Setting --");
+
+		for(int i = 0; i < NLM_FILTER_MODULE_MAX; i++){
+			const char *module = NetLoggingMgrConfig.filter.module[i];
+
+			psvDebugScreenPrintf2(20, 20 + (10 * i),  "module %d : %.*s", i + 1, NLM_FILTER_NAME_LEN, module[0] ? module : "unused");
+		}
+		for(int i = 0; i < NLM_FILTER_PID_MAX; i++){
+			uint32_t pid = NetLoggingMgrConfig.filter.pid[i];
+			int y = 20 + (10 * (NLM_FILTER_MODULE_MAX + i));
+
+			if(pid == 0){
+				psvDebugScreenPrintf2(20, y,  "pid %d    : unused", i + 1);
+			}else{
+				psvDebugScreenPrintf2(20, y,  "pid %d    : 0x%08X", i + 1, pid);
+			}
+		}
+		psvDebugScreenPrintf2(20, 20 + (10 * (sel_max - 1)),  "Back");
+
+		psvDebugScreenSet();
+		swap_fb();
+		psvDebugScreenClear(COLOR_DEFAULT_BG);
+
+		WaitKeyPress();
+
+		if(press_padd & SCE_CTRL_UP){
+			if(sel == 0){
+				sel = sel_max - 1;
+			}else{
+				sel--;
+			}
+		}
+
+		if(press_padd & SCE_CTRL_DOWN){
+			if(sel == (sel_max-1)){
+				sel = 0;
+			}else{
+				sel++;
+			}
+		}
+
+		if(press_padd & SCE_CTRL_CIRCLE){
+			if(sel == (sel_max-1)){
+				break;
+			}else if(sel < NLM_FILTER_MODULE_MAX){
+				SetFilterModule(NetLoggingMgrConfig.filter.module[sel]);
+			}else{
+				SetFilterPid(&NetLoggingMgrConfig.filter.pid[sel - NLM_FILTER_MODULE_MAX]);
+			}
+		}
+
+	}
+
+	ReadPad();
+
+	return 0;
+}
+
 int UpdateConfig(void){
 
 	int search_unk[2];
@@ -570,7 +1249,7 @@ int UpdateConfig(void){
 
 	}
 
-	res = NetLoggingMgrUpdateConfig(&NetLoggingMgrConfig);
+	res = NetLoggingMgrUpdateConfigSized(&NetLoggingMgrConfig, sizeof(NetLoggingMgrConfig));
 	if(res < 0){
 
 		psvDebugScreenPrintf("Update Config Error : 0x%X\n", res);
@@ -579,6 +1258,9 @@ int UpdateConfig(void){
 	}
 
 	psvDebugScreenPrintf("Update Config Success.\n");
+	if(res == NLM_CONFIG_RING_BUSY){
+		psvDebugScreenPrintf("Ring size unchanged, the last resize is still draining. Update again later.\n");
+	}
 
 end:
 
@@ -624,7 +1306,7 @@ end:
 int MainMenu(){
 
 	int sel = 0;
-	int sel_max = 7;
+	int sel_max = 15;
 	int sel_idx = 0;
 	int set_idx = 0;
 	MenuItem_t MenuItem[sel_max];
@@ -641,9 +1323,17 @@ int MainMenu(){
 
 	add_menu_item(&MenuItem[set_idx++], "Set Server IPv4");
 	add_menu_item(&MenuItem[set_idx++], "Set Server Port");
+	add_menu_item(&MenuItem[set_idx++], "Set Ring Size");
 	add_menu_item(&MenuItem[set_idx++], "Qaf Settings");
+	add_menu_item(&MenuItem[set_idx++], "Backpressure Settings");
+	add_menu_item(&MenuItem[set_idx++], "Log Format Settings");
+	add_menu_item(&MenuItem[set_idx++], "Transport Settings");
+	add_menu_item(&MenuItem[set_idx++], "Destination Settings");
+	add_menu_item(&MenuItem[set_idx++], "Filter Settings");
 	add_menu_item(&MenuItem[set_idx++], "Update Config");
 	add_menu_item(&MenuItem[set_idx++], "Save Config");
+	add_menu_item(&MenuItem[set_idx++], "Ring Stats");
+	add_menu_item(&MenuItem[set_idx++], "Dump Recent Logs");
 	add_menu_item(&MenuItem[set_idx++], "System Reboot");
 	add_menu_item(&MenuItem[set_idx++], "Exit");
 
@@ -651,9 +1341,17 @@ int MainMenu(){
 
 	set_item_callback(&MenuItem[set_idx++], SetServerIPv4);
 	set_item_callback(&MenuItem[set_idx++], SetServerPort);
+	set_item_callback(&MenuItem[set_idx++], SetRingSize);
 	set_item_callback(&MenuItem[set_idx++], QafSettings);
+	set_item_callback(&MenuItem[set_idx++], BackpressureSettings);
+	set_item_callback(&MenuItem[set_idx++], LogFormatSettings);
+	set_item_callback(&MenuItem[set_idx++], TransportSettings);
+	set_item_callback(&MenuItem[set_idx++], DestinationSettings);
+	set_item_callback(&MenuItem[set_idx++], FilterSettings);
 	set_item_callback(&MenuItem[set_idx++], UpdateConfig);
 	set_item_callback(&MenuItem[set_idx++], SaveConfig);
+	set_item_callback(&MenuItem[set_idx++], RingStats);
+	set_item_callback(&MenuItem[set_idx++], DumpRecent);
 	set_item_callback(&MenuItem[set_idx++], scePowerRequestColdReset);
 	set_item_callback(&MenuItem[set_idx++], 0);
 
@@ -706,7 +1404,8 @@ int CreateConfigFile(){
 
 	int res = sceIoGetstat("ur0:data/NetLoggingMgrConfig.bin", &stat);
 
-	if(res < 0 || (uint32_t)(stat.st_size) != sizeof(NetLoggingMgrConfig_t)){
+	// older, shorter config files are still valid
+	if(res < 0 || (uint32_t)(stat.st_size) < NLM_CONFIG_MIN_SIZE){
 
 		const char magic[4] = {'N', 'L', 'M', '\0'};
 
@@ -733,7 +1432,7 @@ int ReadConfig(){
 	res = _vshKernelSearchModuleByName("NetLoggingMgr", search_unk);
 	if(res > 0){
 
-		NetLoggingMgrReadConfig(&NetLoggingMgrConfig);
+		NetLoggingMgrReadConfigSized(&NetLoggingMgrConfig, sizeof(NetLoggingMgrConfig));
 		goto end;
 	}
 